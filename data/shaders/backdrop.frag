@@ -6,6 +6,8 @@
  *
  */
 
+#extension GL_GOOGLE_include_directive : enable
+
 //layout (binding = 1) uniform sampler2D samplerColor;
 //layout (binding = 2) uniform sampler2D samplerNormalMap;
 
@@ -19,25 +21,11 @@ layout (location = 0) out vec4 outPosition;
 layout (location = 1) out vec4 outNormal;
 layout (location = 2) out vec4 outAlbedo;
 
-layout (push_constant) uniform Material {
-	vec4 baseColorFactor;
-	vec4 emissiveFactor;
-	vec4 diffuseFactor;
-	vec4 specularFactor;
-	float workflow;
-	int baseColorTextureSet;
-	int physicalDescriptorTextureSet;
-	int normalTextureSet;	
-	int occlusionTextureSet;
-	int emissiveTextureSet;
-	float metallicFactor;	
-	float roughnessFactor;	
-	float alphaMask;	
-	float alphaMaskCutoff;
-} material;
+#include "includes/material_buffer.glsl"
 
 void main() 
 {
+	Material material = materials[materialIndex.index];
 	outPosition = vec4(inWorldPos, 1.0);
 
 	// Calculate normal in tangent space
@@ -6,8 +6,10 @@
  *
  */
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+#extension GL_GOOGLE_include_directive : enable
+
+layout (location = 0) in vec4 inPosQuantized;
+layout (location = 1) in vec2 inNormalOctahedral;
 layout (location = 2) in vec2 inUV;
 
 layout (set = 0, binding = 0) uniform UBOCamera
@@ -27,8 +29,12 @@ layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
 
+#include "includes/compact_vertex.glsl"
+
 void main() 
 {
+	vec3 inPos = decodePosition(inPosQuantized);
+	vec3 inNormal = decodeNormal(inNormalOctahedral);
 	vec4 tmpPos = vec4(inPos, 1.0);
 	tmpPos.y = 1.0f;
 	gl_Position = camera.projection * camera.view * tmpPos;
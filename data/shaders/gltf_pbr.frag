@@ -22,7 +22,7 @@ layout (location = 4) in vec3 inTangent;
 
 #include "includes/material_ids.glsl"
 #include "includes/mrt_target_outputs.glsl"
-#include "includes/push_constant_material.glsl"
+#include "includes/material_buffer.glsl"
 
 void main() 
 {
@@ -6,11 +6,14 @@
  *
  */
 
+#extension GL_GOOGLE_include_directive : enable
+
 layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inJoint0;
+layout (location = 4) in vec4 inWeight0;
 //layout (location = 2) in vec3 inColor;
-//layout (location = 4) in vec3 inTangent;
 
 layout (set = 0, binding = 0) uniform UBOCamera
 {
@@ -18,11 +21,16 @@ layout (set = 0, binding = 0) uniform UBOCamera
 	mat4 view;
 } camera;
 
+// Mesh uniform block (see vkglTF::Mesh::UniformBlock)
 layout (set = 1, binding = 0) uniform Uniform_Data
 {
 	mat4 model;
+	uint firstJoint;
+	uint jointCount;
 } uniform_data;
 
+#include "includes/joint_buffer.glsl"
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outColor;
@@ -31,12 +39,16 @@ layout (location = 4) out vec3 outTangent;
 
 void main() 
 {
+	mat4 model = uniform_data.model;
+	if (uniform_data.jointCount > 0) {
+		model = model * getSkinMatrix(uniform_data.firstJoint, inJoint0, inWeight0);
+	}
 	vec4 tmpPos = vec4(inPos, 1.0);
-	gl_Position = camera.projection * camera.view * uniform_data.model * tmpPos;
+	gl_Position = camera.projection * camera.view * model * tmpPos;
 	outUV = inUV;
-	outWorldPos = vec3(uniform_data.model * tmpPos);
+	outWorldPos = vec3(model * tmpPos);
 	outWorldPos.y = -outWorldPos.y;
-	mat3 mNormal = transpose(inverse(mat3(uniform_data.model)));
+	mat3 mNormal = transpose(inverse(mat3(model)));
 	outNormal = mNormal * normalize(inNormal);	
 	outTangent = mNormal * normalize(vec3(1.0f));
 	outColor = vec3(1.0f);
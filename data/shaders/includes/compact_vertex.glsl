@@ -0,0 +1,20 @@
+// Decoding of the compact static mesh vertex format (see vkglTF::Model::CompactVertex)
+// Positions are 16 bit snorm relative to the model's bounding box (center in xyz, half extent of the largest axis in w)
+// Normals are octahedral encoded as 16 bit snorm
+layout (push_constant) uniform VertexDequantization {
+	layout (offset = 16) vec4 positionCenterExtent;
+} vertexDequantization;
+
+vec3 decodePosition(vec4 quantized)
+{
+	return vertexDequantization.positionCenterExtent.xyz + quantized.xyz * vertexDequantization.positionCenterExtent.w;
+}
+
+vec3 decodeNormal(vec2 octahedral)
+{
+	vec3 n = vec3(octahedral.xy, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
@@ -0,0 +1,14 @@
+// Joint matrices of all skins are stored in a single storage buffer (see JointBuffer)
+// A skinned mesh uses the range starting at its skin's first joint
+layout (set = 0, binding = 2) readonly buffer Joints {
+	mat4 jointMatrices[];
+};
+
+mat4 getSkinMatrix(uint firstJoint, vec4 joints, vec4 weights)
+{
+	return
+		weights.x * jointMatrices[firstJoint + uint(joints.x)] +
+		weights.y * jointMatrices[firstJoint + uint(joints.y)] +
+		weights.z * jointMatrices[firstJoint + uint(joints.z)] +
+		weights.w * jointMatrices[firstJoint + uint(joints.w)];
+}
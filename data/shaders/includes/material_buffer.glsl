@@ -0,0 +1,26 @@
+// Material parameters of all models are stored in a single storage buffer (see vkglTF::ShaderMaterial)
+// Draws only pass the index of their material as a push constant
+struct Material {
+	vec4 baseColorFactor;
+	vec4 emissiveFactor;
+	vec4 diffuseFactor;
+	vec4 specularFactor;
+	float workflow;
+	int baseColorTextureSet;
+	int physicalDescriptorTextureSet;
+	int normalTextureSet;	
+	int occlusionTextureSet;
+	int emissiveTextureSet;
+	float metallicFactor;	
+	float roughnessFactor;	
+	float alphaMask;	
+	float alphaMaskCutoff;
+};
+
+layout (set = 0, binding = 1) readonly buffer Materials {
+	Material materials[];
+};
+
+layout (push_constant) uniform MaterialIndex {
+	uint index;
+} materialIndex;
@@ -21,10 +21,11 @@ layout (location = 0) out vec4 outPosition;
 layout (location = 1) out vec4 outNormal;
 layout (location = 2) out vec4 outAlbedo;
 
-#include "includes/push_constant_material.glsl"
+#include "includes/material_buffer.glsl"
 
 void main() 
 {
+	Material material = materials[materialIndex.index];
 	outPosition = vec4(inWorldPos, 1.0);
 
 	// Calculate normal in tangent space
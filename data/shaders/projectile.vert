@@ -6,8 +6,10 @@
  *
  */
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+#extension GL_GOOGLE_include_directive : enable
+
+layout (location = 0) in vec4 inPosQuantized;
+layout (location = 1) in vec2 inNormalOctahedral;
 layout (location = 2) in vec2 inUV;
 
 layout (set = 0, binding = 0) uniform UBOCamera
@@ -16,9 +18,10 @@ layout (set = 0, binding = 0) uniform UBOCamera
 	mat4 view;
 } camera;
 
-layout (set = 1, binding = 0) uniform UBOPositions
+// Alive projectiles compacted by type, each type is drawn with its first instance set to the start of its range
+layout (set = 1, binding = 0) readonly buffer Positions
 {
-	vec4[512] pos;
+	vec4 pos[];
 } positions;
 
 layout (location = 0) out vec3 outNormal;
@@ -27,8 +30,12 @@ layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
 
+#include "includes/compact_vertex.glsl"
+
 void main() 
 {
+	vec3 inPos = decodePosition(inPosQuantized);
+	vec3 inNormal = decodeNormal(inNormalOctahedral);
 	vec4 tmpPos = vec4(inPos + positions.pos[gl_InstanceIndex].xyz, 1.0);
 	gl_Position = camera.projection * camera.view * tmpPos;
 	outUV = inUV;
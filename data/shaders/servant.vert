@@ -0,0 +1,47 @@
+#version 450
+
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#extension GL_GOOGLE_include_directive : enable
+
+layout (location = 0) in vec4 inPosQuantized;
+layout (location = 1) in vec2 inNormalOctahedral;
+layout (location = 2) in vec2 inUV;
+//layout (location = 2) in vec3 inColor;
+//layout (location = 4) in vec3 inTangent;
+// Per-instance model matrix (see Game::drawServants)
+layout (location = 3) in mat4 instanceModel;
+
+layout (set = 0, binding = 0) uniform UBOCamera
+{
+	mat4 projection;
+	mat4 view;
+} camera;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outColor;
+layout (location = 3) out vec3 outWorldPos;
+layout (location = 4) out vec3 outTangent;
+
+#include "includes/compact_vertex.glsl"
+
+void main() 
+{
+	vec3 inPos = decodePosition(inPosQuantized);
+	vec3 inNormal = decodeNormal(inNormalOctahedral);
+	vec4 tmpPos = vec4(inPos, 1.0);
+	gl_Position = camera.projection * camera.view * instanceModel * tmpPos;
+	outUV = inUV;
+	outUV.t = 1.0 - outUV.t;
+	outWorldPos = vec3(instanceModel * tmpPos);
+	outWorldPos.y = -outWorldPos.y;
+	mat3 mNormal = transpose(inverse(mat3(instanceModel)));
+	outNormal = mNormal * normalize(inNormal);	
+	outTangent = mNormal * normalize(vec3(1.0f));
+	outColor = vec3(1.0f);
+}
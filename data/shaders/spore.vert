@@ -6,8 +6,10 @@
  *
  */
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+#extension GL_GOOGLE_include_directive : enable
+
+layout (location = 0) in vec4 inPosQuantized;
+layout (location = 1) in vec2 inNormalOctahedral;
 layout (location = 2) in vec2 inUV;
 
 // Instanced attributes
@@ -31,8 +33,12 @@ layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
 
+#include "includes/compact_vertex.glsl"
+
 void main() 
 {
+	vec3 inPos = decodePosition(inPosQuantized);
+	vec3 inNormal = decodeNormal(inNormalOctahedral);
 	vec4 tmpPos = vec4(instancePos + (inPos * instanceScale) , 1.0);
 	gl_Position = camera.projection * camera.view * tmpPos;
 	outUV = inUV;
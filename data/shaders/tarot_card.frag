@@ -18,10 +18,11 @@ layout (location = 4) in vec3 inTangent;
 
 #include "includes/material_ids.glsl"
 #include "includes/mrt_target_outputs.glsl"
-#include "includes/push_constant_material.glsl"
+#include "includes/material_buffer.glsl"
 
 void main() 
 {
+	Material material = materials[materialIndex.index];
 	// Calculate normal in tangent space
 	vec3 N = normalize(inNormal);
 	N.y = -N.y;
@@ -0,0 +1,175 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+// Plain atomics and constant initialized members, as allocations and zone registrations may happen before any constructors have run
+namespace
+{
+	std::atomic<uint64_t> frameAllocations{ 0 };
+	std::atomic<uint64_t> frameBytes{ 0 };
+	AllocationTracker::Counters lastFrame;
+	const char* zoneNames[AllocationTracker::maxZoneCount];
+	std::atomic<uint64_t> zoneAllocations[AllocationTracker::maxZoneCount];
+	std::atomic<uint64_t> zoneBytes[AllocationTracker::maxZoneCount];
+	AllocationTracker::Counters zonesLastFrame[AllocationTracker::maxZoneCount];
+	std::atomic<uint32_t> zoneCount{ 0 };
+	std::mutex zoneMutex;
+	thread_local uint32_t currentZone = AllocationTracker::noZone;
+}
+
+bool AllocationTracker::available()
+{
+#if defined(TRACK_ALLOCATIONS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AllocationTracker::recordAllocation(size_t size)
+{
+	frameAllocations.fetch_add(1, std::memory_order_relaxed);
+	frameBytes.fetch_add(size, std::memory_order_relaxed);
+	const uint32_t zone = currentZone;
+	if (zone != noZone) {
+		zoneAllocations[zone].fetch_add(1, std::memory_order_relaxed);
+		zoneBytes[zone].fetch_add(size, std::memory_order_relaxed);
+	}
+}
+
+// Returns the index of the zone with the given name, zones are never removed
+uint32_t AllocationTracker::registerZone(const char* name)
+{
+	std::lock_guard<std::mutex> lock(zoneMutex);
+	const uint32_t count = zoneCount.load();
+	for (uint32_t i = 0; i < count; i++) {
+		if ((zoneNames[i] == name) || (strcmp(zoneNames[i], name) == 0)) {
+			return i;
+		}
+	}
+	if (count >= maxZoneCount) {
+		return noZone;
+	}
+	zoneNames[count] = name;
+	zoneCount.store(count + 1);
+	return count;
+}
+
+// Sets the zone for the calling thread and returns the previous one
+uint32_t AllocationTracker::setCurrentZone(uint32_t zone)
+{
+	const uint32_t previousZone = currentZone;
+	currentZone = zone;
+	return previousZone;
+}
+
+void AllocationTracker::beginFrame()
+{
+	lastFrame.allocations = frameAllocations.exchange(0);
+	lastFrame.bytes = frameBytes.exchange(0);
+	const uint32_t count = zoneCount.load();
+	for (uint32_t i = 0; i < count; i++) {
+		zonesLastFrame[i].allocations = zoneAllocations[i].exchange(0);
+		zonesLastFrame[i].bytes = zoneBytes[i].exchange(0);
+	}
+}
+
+AllocationTracker::Counters AllocationTracker::getLastFrame()
+{
+	return lastFrame;
+}
+
+uint32_t AllocationTracker::getZoneCount()
+{
+	return zoneCount.load();
+}
+
+const char* AllocationTracker::getZoneName(uint32_t zone)
+{
+	return zoneNames[zone];
+}
+
+AllocationTracker::Counters AllocationTracker::getZoneLastFrame(uint32_t zone)
+{
+	return zonesLastFrame[zone];
+}
+
+AllocationZone::AllocationZone(uint32_t zone)
+{
+	previousZone = AllocationTracker::setCurrentZone(zone);
+}
+
+AllocationZone::~AllocationZone()
+{
+	AllocationTracker::setCurrentZone(previousZone);
+}
+
+#if defined(TRACK_ALLOCATIONS)
+// Replacements for the global allocation functions, aligned variants are not counted
+
+void* operator new(size_t size)
+{
+	AllocationTracker::recordAllocation(size);
+	void* ptr = malloc(size > 0 ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	AllocationTracker::recordAllocation(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+#endif
@@ -0,0 +1,44 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Counts heap allocations done with the global operator new per frame and per zone
+// Global new/delete are only hooked if built with TRACK_ALLOCATIONS (CMake option), otherwise all counters stay zero
+class AllocationTracker
+{
+public:
+	struct Counters {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+	};
+	static const uint32_t maxZoneCount = 32;
+	static const uint32_t noZone = UINT32_MAX;
+	static bool available();
+	static void recordAllocation(size_t size);
+	// Not meant for per-frame use, register zones once (e.g. at static initialization) and keep the returned index
+	static uint32_t registerZone(const char* name);
+	static uint32_t setCurrentZone(uint32_t zone);
+	static void beginFrame();
+	static Counters getLastFrame();
+	static uint32_t getZoneCount();
+	static const char* getZoneName(uint32_t zone);
+	static Counters getZoneLastFrame(uint32_t zone);
+};
+
+// Attributes allocations on the current thread to a zone while in scope, zones can be nested
+// Zones are registered once with AllocationTracker::registerZone, entering one only swaps a thread local index
+class AllocationZone
+{
+private:
+	uint32_t previousZone;
+public:
+	AllocationZone(uint32_t zone);
+	~AllocationZone();
+};
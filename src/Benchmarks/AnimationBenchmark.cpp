@@ -0,0 +1,112 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+// Standalone benchmark comparing glTF animation updates against uncached world matrices and linear keyframe scans
+// Uses a generated chain of nested nodes, each with a rotation channel and used as a joint of a skin at the end of the chain
+// Runs on the CPU only, the joint matrices are calculated like Node::update does but written to local memory
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include "../Renderer/VulkanglTFModel.h"
+
+int main(int argc, char* argv[])
+{
+	const uint32_t depth = 128;
+	const uint32_t keyframeCount = 1024;
+	const uint32_t iterations = 1000;
+
+	vkglTF::Model* model = new vkglTF::Model();
+	vkglTF::Skin* skin = new vkglTF::Skin();
+	vkglTF::Animation animation{};
+	vkglTF::Node* parent = nullptr;
+	for (uint32_t i = 0; i < depth; i++) {
+		vkglTF::Node* node = new vkglTF::Node{};
+		node->index = i;
+		node->parent = parent;
+		node->matrix = glm::mat4(1.0f);
+		node->translation = glm::vec3(0.0f, 0.1f, 0.0f);
+		if (parent) {
+			parent->children.push_back(node);
+		}
+		else {
+			model->nodes.push_back(node);
+		}
+		model->linearNodes.push_back(node);
+		skin->joints.push_back(node);
+		skin->inverseBindMatrices.push_back(glm::mat4(1.0f));
+		vkglTF::AnimationSampler sampler{};
+		sampler.interpolation = vkglTF::AnimationSampler::InterpolationType::LINEAR;
+		for (uint32_t k = 0; k < keyframeCount; k++) {
+			const glm::quat q = glm::angleAxis(glm::radians((float)k), glm::vec3(0.0f, 0.0f, 1.0f));
+			sampler.inputs.push_back((float)k / 30.0f);
+			sampler.outputsVec4.push_back(glm::vec4(q.x, q.y, q.z, q.w));
+		}
+		vkglTF::AnimationChannel channel{};
+		channel.path = vkglTF::AnimationChannel::PathType::ROTATION;
+		channel.node = node;
+		channel.samplerIndex = i;
+		animation.samplers.push_back(sampler);
+		animation.channels.push_back(channel);
+		parent = node;
+	}
+	std::vector<glm::mat4> jointMatrices(depth);
+	std::vector<glm::mat4> referenceJointMatrices(depth);
+	parent->skin = skin;
+	model->skins.push_back(skin);
+	model->animations.push_back(animation);
+	model->updateNodes();
+
+	const float duration = model->animations[0].samplers[0].inputs.back();
+	auto uncachedMatrix = [](vkglTF::Node* node) {
+		glm::mat4 m = node->localMatrix();
+		for (vkglTF::Node* p = node->parent; p; p = p->parent) {
+			m = p->localMatrix() * m;
+		}
+		return m;
+	};
+
+	// Reference: keyframes are scanned linearly and every joint walks up the hierarchy
+	auto tStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		const float time = duration * (float)i / (float)iterations;
+		for (auto& channel : model->animations[0].channels) {
+			vkglTF::AnimationSampler& sampler = model->animations[0].samplers[channel.samplerIndex];
+			for (size_t k = 0; k < sampler.inputs.size() - 1; k++) {
+				if ((time >= sampler.inputs[k]) && (time <= sampler.inputs[k + 1])) {
+					sampler.rotate(k, time, channel.node);
+				}
+			}
+		}
+		const glm::mat4 inverseTransform = glm::inverse(uncachedMatrix(parent));
+		for (size_t j = 0; j < skin->joints.size(); j++) {
+			referenceJointMatrices[j] = inverseTransform * uncachedMatrix(skin->joints[j]) * skin->inverseBindMatrices[j];
+		}
+	}
+	const double referenceTime = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - tStart).count() / iterations;
+
+	tStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		model->updateAnimation(0, duration * (float)i / (float)iterations);
+		const glm::mat4 inverseTransform = glm::inverse(parent->getMatrix());
+		for (size_t j = 0; j < skin->joints.size(); j++) {
+			jointMatrices[j] = inverseTransform * skin->joints[j]->getMatrix() * skin->inverseBindMatrices[j];
+		}
+	}
+	const double cachedTime = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - tStart).count() / iterations;
+
+	std::clog << "Animation benchmark (" << depth << " nested nodes, " << keyframeCount << " keyframes per channel): " << referenceTime << " us per update uncached, " << cachedTime << " us per update with cached matrices and keyframe cursors" << std::endl;
+
+	// No GPU resources were created, so the model can be destroyed without a device
+	model->destroy(VK_NULL_HANDLE);
+	delete skin;
+	delete model;
+	return 0;
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+// Standalone benchmark comparing laying out HUD style strings from scratch with looking them up in the shaped run cache
+// Uses generated glyph metrics for printable ASCII, so no font file or GPU resources are required
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "../UI/Font.h"
+#include "../UI/TextLayout.h"
+
+int main(int argc, char* argv[])
+{
+	const uint32_t stringCount = 64;
+	const uint32_t iterations = 10000;
+
+	UI::Font* font = new UI::Font();
+	font->name = "generated";
+	font->lineHeight = 64.0f;
+	font->texture = nullptr;
+	for (uint32_t c = ' '; c <= '~'; c++) {
+		UI::FontCharInfo& ci = font->glyphs[c];
+		ci.x = (float)((c - ' ') % 16) * 32.0f;
+		ci.y = (float)((c - ' ') / 16) * 64.0f;
+		ci.width = 28.0f;
+		ci.height = 48.0f;
+		ci.xoffset = 2.0f;
+		ci.yoffset = 8.0f;
+		ci.xadvance = 30.0f;
+		ci.uvMin = glm::vec2(ci.x, ci.y) / 512.0f;
+		ci.uvMax = glm::vec2(ci.x + ci.width, ci.y + ci.height) / 512.0f;
+	}
+
+	std::vector<std::string> strings;
+	size_t glyphCount = 0;
+	for (uint32_t i = 0; i < stringCount; i++) {
+		strings.push_back("Score " + std::to_string(i * 250) + "\nWave " + std::to_string(i % 8));
+		glyphCount += strings.back().size();
+	}
+	const glm::vec2 scale = glm::vec2(0.0025f);
+
+	size_t quadCount = 0;
+	auto tStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		quadCount += UI::ShapedRunCache::shape(font, strings[i % stringCount], scale).quads.size();
+	}
+	const double uncachedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+	UI::ShapedRunCache cache;
+	tStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		quadCount += cache.get(font, strings[i % stringCount], scale).quads.size();
+	}
+	const double cachedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+	const double glyphsPerIteration = (double)glyphCount / (double)stringCount;
+	std::clog << "Text layout benchmark (" << stringCount << " strings, " << iterations << " layouts, " << quadCount << " quads): " << (glyphsPerIteration * iterations) / uncachedTime << " glyphs/ms shaped, " << (glyphsPerIteration * iterations) / cachedTime << " glyphs/ms cached (" << cache.stats.hits << " hits, " << cache.stats.misses << " misses)" << std::endl;
+
+	delete font;
+	return 0;
+}
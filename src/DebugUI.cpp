@@ -57,6 +57,7 @@ void DebugUI::prepareGPUResources(const VkPipelineCache pipelineCache, RenderPas
 	fontImage->setExtent({ (uint32_t)texWidth, (uint32_t)texHeight, 1 });
 	fontImage->setTiling(VK_IMAGE_TILING_OPTIMAL);
 	fontImage->setUsage(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	fontImage->setMemoryCategory(MemoryCategory::Textures);
 	fontImage->create();
 
 	fontImageView = new ImageView(renderer->device);
@@ -66,54 +67,14 @@ void DebugUI::prepareGPUResources(const VkPipelineCache pipelineCache, RenderPas
 	fontImageView->setImage(fontImage);
 	fontImageView->create();
 
-	// Staging buffers for font data upload
-	Buffer stagingBuffer;
-	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &stagingBuffer, uploadSize));
-	memcpy(stagingBuffer.mapped, fontData, uploadSize);
-
-	// Copy buffer data to font image
-	VkCommandBuffer copyCmd = renderer->device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-	// Prepare for transfer
-	vks::tools::setImageLayout(
-		copyCmd,
-		fontImage->handle,
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_PIPELINE_STAGE_HOST_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-	// Copy
+	// Copy font data to the image via the batched staging arena
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	bufferCopyRegion.imageSubresource.layerCount = 1;
 	bufferCopyRegion.imageExtent.width = texWidth;
 	bufferCopyRegion.imageExtent.height = texHeight;
 	bufferCopyRegion.imageExtent.depth = 1;
-
-	vkCmdCopyBufferToImage(
-		copyCmd,
-		stagingBuffer.buffer,
-		fontImage->handle,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&bufferCopyRegion
-	);
-
-	// Prepare for shader read
-	vks::tools::setImageLayout(
-		copyCmd,
-		fontImage->handle,
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-
-	renderer->device->flushCommandBuffer(copyCmd, renderer->queue, true);
-
-	stagingBuffer.destroy();
+	renderer->device->uploadManager->uploadImage(fontImage->handle, fontData, uploadSize, { bufferCopyRegion }, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 	sampler = new Sampler(renderer->device);
 	sampler->setMinFilter(VK_FILTER_LINEAR);
@@ -216,24 +177,23 @@ void DebugUI::updateGPUResources()
 	VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
 	VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
-	// Update buffers only if vertex or index count has been changed compared to current buffer size
 	if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
 		return;
 	}
 
-	// Vertex buffer
-	if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
+	// Buffers grow geometrically, so they're only recreated a few times
+	// Only one frame is in flight and this is called after waiting for it, so the old buffers are no longer in use
+	if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCapacity < imDrawData->TotalVtxCount)) {
 		vertexBuffer.destroy();
-		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &vertexBuffer, vertexBufferSize));
-		vertexCount = imDrawData->TotalVtxCount;
+		vertexCapacity = std::max(imDrawData->TotalVtxCount, vertexCapacity * 2);
+		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &vertexBuffer, vertexCapacity * sizeof(ImDrawVert), nullptr, MemoryCategory::Geometry));
+		stats.bufferAllocations++;
 	}
-
-	// Index buffer
-	VkDeviceSize indexSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-	if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
+	if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCapacity < imDrawData->TotalIdxCount)) {
 		indexBuffer.destroy();
-		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &indexBuffer, indexBufferSize));
-		indexCount = imDrawData->TotalIdxCount;
+		indexCapacity = std::max(imDrawData->TotalIdxCount, indexCapacity * 2);
+		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &indexBuffer, indexCapacity * sizeof(ImDrawIdx), nullptr, MemoryCategory::Geometry));
+		stats.bufferAllocations++;
 	}
 
 	// Upload data
@@ -367,6 +327,18 @@ void cellInfo(Cell* cell, bool showOwner, bool showNeighbours)
 
 void DebugUI::render()
 {
+	// In throttled mode the draw data of the last rebuild stays valid until the next call to ImGui::NewFrame and is drawn again
+	auto tNow = std::chrono::high_resolution_clock::now();
+	if ((refreshRate > 0.0f) && ImGui::GetDrawData()) {
+		const float elapsed = std::chrono::duration<float>(tNow - lastRebuild).count();
+		if (elapsed < 1.0f / refreshRate) {
+			stats.skippedFrames++;
+			return;
+		}
+	}
+	lastRebuild = tNow;
+	stats.rebuilds++;
+
 	ImVec2 btnSize = ImVec2(100.0f, 25.0f);
 	ImVec4 colorGood = ImVec4(1.0f, 0.6f, 0.24f, 1.0f);
 	ImVec4 colorEvil = ImVec4(0.0f, 0.0f, 0.74f, 1.0f);
@@ -387,6 +359,20 @@ void DebugUI::render()
 		DisplayPerformanceValue("cb build", timing.commandbufferbuild);
 		DisplayPerformanceValue("playfield update", timing.playfieldupdate);
 	}
+	ImGui::SliderFloat("refresh rate (0 = every frame)", &refreshRate, 0.0f, 60.0f, "%.0f Hz");
+	ImGui::Text("debug ui: %d rebuilds, %d skipped, %d buffer allocations", stats.rebuilds, stats.skippedFrames, stats.bufferAllocations);
+	if (AllocationTracker::available()) {
+		const AllocationTracker::Counters heapAllocations = AllocationTracker::getLastFrame();
+		ImGui::Text("heap allocations: %d (%d bytes)", (int)heapAllocations.allocations, (int)heapAllocations.bytes);
+		for (uint32_t i = 0; i < AllocationTracker::getZoneCount(); i++) {
+			const AllocationTracker::Counters zone = AllocationTracker::getZoneLastFrame(i);
+			ImGui::Text("  %s: %d (%d bytes)", AllocationTracker::getZoneName(i), (int)zone.allocations, (int)zone.bytes);
+		}
+	}
+	else {
+		ImGui::Text("heap allocations: not tracked (build with TRACK_ALLOCATIONS)");
+	}
+	ImGui::Text("frame allocator: %d bytes, peak %d of %d, %d overflows", (int)frameAllocator->stats.bytesLastFrame, (int)frameAllocator->stats.peakBytes, (int)frameAllocator->getCapacity(), frameAllocator->stats.overflows);
 	ImGui::End();
 
 	ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiSetCond_FirstUseEver);
@@ -609,6 +595,35 @@ void DebugUI::render()
 			ofstream.close();
 		}
 	}
+	ImGui::Text("Unique samplers: %d", renderer->device->samplerCache->getSamplerCount());
+	ImGui::Text("Descriptor sets: %d", renderer->descriptorAllocator->stats.allocatedSets);
+	ImGui::Text("Descriptor sets allocated last frame: %d", renderer->descriptorAllocator->stats.allocationsLastFrame);
+	ImGui::Text("Descriptor pools: %d", renderer->descriptorAllocator->stats.poolCount);
+	ImGui::Text("Entity transforms: %d", renderer->transformBuffer->getSlotCount());
+	ImGui::Text("Instanced draws: %d (%d bytes)", renderer->instanceBuffer->stats.allocationsLastFrame, (int)renderer->instanceBuffer->stats.bytesLastFrame);
+	ImGui::Text("Game UI: %d buffer allocations, %d layouts, %d uploads", gameUI->stats.bufferAllocations, gameUI->stats.layouts, gameUI->stats.uploads);
+	ImGui::Text("Shaped text runs: %d cached, %d hits, %d misses", (int)gameUI->runCache.size(), gameUI->runCache.stats.hits, gameUI->runCache.stats.misses);
+	ImGui::End();
+
+	// Live GPU memory usage, heap budgets come from VK_EXT_memory_budget if available
+	ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
+	ImGui::Begin("GPU memory", nullptr, ImGuiWindowFlags_None);
+	MemoryTracker* memoryTracker = renderer->device->memoryTracker;
+	const float mb = 1024.0f * 1024.0f;
+	ImGui::Text("Heaps (%s):", memoryTracker->budgetExtension ? "driver budget" : "estimated budget");
+	const std::vector<MemoryTracker::HeapBudget>& heapBudgets = memoryTracker->getHeapBudgets();
+	for (size_t i = 0; i < heapBudgets.size(); i++) {
+		const MemoryTracker::HeapBudget& heap = heapBudgets[i];
+		ImGui::Text("%d %s: %.1f / %.1f MB (peak %.1f MB)", (int)i, heap.deviceLocal ? "device" : "host", heap.usage / mb, heap.budget / mb, heap.peakUsage / mb);
+		ImGui::ProgressBar(heap.budget > 0 ? (float)heap.usage / (float)heap.budget : 0.0f, ImVec2(200.0f, 0.0f));
+	}
+	ImGui::Separator();
+	for (uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++) {
+		const MemoryTracker::CategoryStats stats = memoryTracker->getCategoryStats((MemoryCategory)i);
+		ImGui::Text("%s: %d (%.2f MB), peak %d (%.2f MB)", MemoryTracker::getCategoryName((MemoryCategory)i), stats.count, stats.bytes / mb, stats.peakCount, stats.peakBytes / mb);
+	}
+	ImGui::Separator();
+	ImGui::Text("Last frame: %d allocations, %d frees", memoryTracker->lastFrame.allocations, memoryTracker->lastFrame.frees);
 	ImGui::End();
 
 	ImGui::EndFrame();
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <fstream>
+#include <chrono>
 #include "imgui.h"
 
 #include "Game.h"
@@ -16,6 +17,8 @@
 #include "Guardian.h"
 #include "TarotDeck.h"
 #include "PlayingField.h"
+#include "AllocationTracker.h"
+#include "FrameAllocator.h"
 #include "Renderer/VulkanTools.h"
 #include "Renderer/AssetManager.h"
 #include "Renderer/PipelineLayout.h"
@@ -52,10 +55,12 @@ class DebugUI: public RenderObject, public GameInputListener
 {
 private:
 	bool visible = true;
+	// Persistent buffers, only recreated if the draw data outgrows them
 	Buffer vertexBuffer;
 	Buffer indexBuffer;
-	int32_t vertexCount = 0;
-	int32_t indexCount = 0;
+	int32_t vertexCapacity = 0;
+	int32_t indexCapacity = 0;
+	std::chrono::time_point<std::chrono::high_resolution_clock> lastRebuild;
 	DescriptorPool* descriptorPool;
 	DescriptorSetLayout* descriptorSetLayout;
 	DescriptorSet* descriptorSet;
@@ -79,6 +84,13 @@ public:
 		PerformanceValue playfieldupdate;
 		PerformanceValue fps;
 	} timing;
+	// Rate in Hz at which the draw data is rebuilt, the previous draw data is reused in between (0 = every frame)
+	float refreshRate = 0.0f;
+	struct Stats {
+		uint32_t rebuilds = 0;
+		uint32_t skippedFrames = 0;
+		uint32_t bufferAllocations = 0;
+	} stats;
 	Game* game;
 	Player* player;
 	Guardian* guardian;
@@ -0,0 +1,70 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "FrameAllocator.h"
+
+#include <cstdlib>
+#include <cassert>
+#include <iostream>
+#include <string>
+
+FrameAllocator* frameAllocator = nullptr;
+
+FrameAllocator::FrameAllocator(size_t capacity)
+{
+	this->capacity = capacity;
+	memory = static_cast<unsigned char*>(malloc(capacity));
+}
+
+FrameAllocator::~FrameAllocator()
+{
+	reset();
+	free(memory);
+}
+
+void* FrameAllocator::allocate(size_t size, size_t alignment)
+{
+	assert((alignment & (alignment - 1)) == 0);
+	const size_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+	if (alignedOffset + size <= capacity) {
+		offset = alignedOffset + size;
+		return memory + alignedOffset;
+	}
+	void* ptr = malloc(size + alignment);
+	overflowAllocations.push_back(ptr);
+	overflowBytes += size + alignment;
+	stats.overflows++;
+	const uintptr_t address = (reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	return reinterpret_cast<void*>(address);
+}
+
+// Releases all allocations of the current frame, everything allocated from this allocator must no longer be used
+void FrameAllocator::reset()
+{
+	const size_t usedBytes = offset + overflowBytes;
+	stats.bytesLastFrame = usedBytes;
+	if (usedBytes > stats.peakBytes) {
+		stats.peakBytes = usedBytes;
+	}
+	for (void* ptr : overflowAllocations) {
+		free(ptr);
+	}
+	overflowAllocations.clear();
+	// Grow so the next frame with the same usage fits into the arena
+	if (usedBytes > capacity) {
+		std::clog << "Frame allocator grows from " + std::to_string(capacity) + " to " + std::to_string(usedBytes * 2) + " bytes\n";
+		free(memory);
+		capacity = usedBytes * 2;
+		memory = static_cast<unsigned char*>(malloc(capacity));
+	}
+	offset = 0;
+	overflowBytes = 0;
+}
+
+size_t FrameAllocator::getCapacity()
+{
+	return capacity;
+}
@@ -0,0 +1,59 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Linear allocator for temporary data that only lives for the current frame
+// Memory is handed out by bumping an offset and released all at once with reset at the start of the next frame
+// If a frame needs more than the capacity, the overflow is taken from the heap and the arena grows on the next reset
+// Not thread safe, only use from the main thread
+class FrameAllocator
+{
+private:
+	unsigned char* memory = nullptr;
+	size_t capacity;
+	size_t offset = 0;
+	std::vector<void*> overflowAllocations;
+	size_t overflowBytes = 0;
+public:
+	struct Stats {
+		size_t bytesLastFrame = 0;
+		size_t peakBytes = 0;
+		uint32_t overflows = 0;
+	} stats;
+	FrameAllocator(size_t capacity);
+	~FrameAllocator();
+	void* allocate(size_t size, size_t alignment);
+	void reset();
+	size_t getCapacity();
+};
+
+extern FrameAllocator* frameAllocator;
+
+// STL allocator on top of the global frame allocator, memory is only released on reset
+template<typename T>
+class FrameStlAllocator
+{
+public:
+	typedef T value_type;
+	FrameStlAllocator() = default;
+	template<typename U> FrameStlAllocator(const FrameStlAllocator<U>&) {}
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(frameAllocator->allocate(sizeof(T) * count, alignof(T)));
+	}
+	void deallocate(T*, size_t) {}
+	template<typename U> bool operator==(const FrameStlAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const FrameStlAllocator<U>&) const { return false; }
+};
+
+// Vector for per-frame temporaries, must not outlive the frame it was created in
+template<typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
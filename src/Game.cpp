@@ -21,6 +21,8 @@ Game::~Game()
 	for (auto servant : servants) {
 		delete servant;
 	}
+	delete descriptorSetProjectiles;
+	projectilesSsbo.destroy();
 }
 
 void Game::spawnTrigger()
@@ -235,23 +237,100 @@ void Game::updateProjectiles(float dT)
 
 void Game::prepareGPUResources()
 {
-	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &projectilesUbo, gameState->values.maxNumProjectiles * sizeof(glm::vec4)));
+	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &projectilesSsbo, gameState->values.maxNumProjectiles * sizeof(glm::vec4), nullptr, MemoryCategory::Uniforms));
 	descriptorSetProjectiles = new DescriptorSet(renderer->device->handle);
-	descriptorSetProjectiles->setPool(renderer->descriptorPool);
-	descriptorSetProjectiles->addLayout(renderer->getDescriptorSetLayout("single_ubo"));
-	descriptorSetProjectiles->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &projectilesUbo.descriptor);
+	descriptorSetProjectiles->setAllocator(renderer->descriptorAllocator);
+	descriptorSetProjectiles->addLayout(renderer->getDescriptorSetLayout("single_ssbo"));
+	descriptorSetProjectiles->addDescriptor(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &projectilesSsbo.descriptor);
 	descriptorSetProjectiles->create();
+	projectileModel = assetManager->getModel("projectile_player");
+	portalSpawnerModel = assetManager->getModel("portal_spawner_good");
+	renderer->checkModelVertexFormat("projectile", "projectile_player");
+	renderer->checkModelVertexFormat("projectile", "portal_spawner_good");
+	projectilePipeline = renderer->getPipeline("projectile");
+	projectilePipelineLayout = renderer->getPipelineLayout("projectiles");
+	servantPipeline = renderer->getPipeline("servant");
+	servantPipelineLayout = renderer->getPipelineLayout("split_ubo");
 }
 
 void Game::updateGPUResources()
 {
 	playingField->updateGPUResources();
-	if (gameState->projectiles.size() > 0) {
-		std::vector<glm::vec4> uniformdata(gameState->projectiles.size());
-		for (size_t i = 0; i < gameState->projectiles.size(); i++) {
-			uniformdata[i] = glm::vec4(gameState->projectiles[i].pos, 0.0f);
+}
+
+// Alive projectiles are compacted into the storage buffer grouped by type, so each type is drawn with a single instanced draw
+// The buffer is written while recording, which is safe as only one frame is in flight
+void Game::drawProjectiles(CommandBuffer* cb)
+{
+	const uint32_t typeCount = static_cast<uint32_t>(ProjectileType::Evil_Portal_Spawn) + 1;
+	std::array<uint32_t, typeCount> instanceCounts{};
+	for (auto& projectile : gameState->projectiles) {
+		if (projectile.alive) {
+			instanceCounts[static_cast<uint32_t>(projectile.type)]++;
+		}
+	}
+	std::array<uint32_t, typeCount> firstInstances{};
+	uint32_t aliveCount = 0;
+	for (uint32_t i = 0; i < typeCount; i++) {
+		firstInstances[i] = aliveCount;
+		aliveCount += instanceCounts[i];
+	}
+	if (aliveCount == 0) {
+		return;
+	}
+	std::array<uint32_t, typeCount> writeIndices = firstInstances;
+	glm::vec4* positions = static_cast<glm::vec4*>(projectilesSsbo.mapped);
+	for (auto& projectile : gameState->projectiles) {
+		if (projectile.alive) {
+			positions[writeIndices[static_cast<uint32_t>(projectile.type)]++] = glm::vec4(projectile.pos, 0.0f);
+		}
+	}
+
+	cb->bindPipeline(projectilePipeline);
+	cb->bindDescriptorSets(projectilePipelineLayout, { renderer->descriptorSets.camera, descriptorSetProjectiles }, 0);
+	for (uint32_t i = 0; i < typeCount; i++) {
+		if (instanceCounts[i] == 0) {
+			continue;
+		}
+		vkglTF::Model* model = (static_cast<ProjectileType>(i) == ProjectileType::Good_Portal_Spawn) ? portalSpawnerModel : projectileModel;
+		model->draw(cb->handle, projectilePipelineLayout->handle, firstInstances[i], instanceCounts[i]);
+	}
+}
+
+// Servants sharing a model are batched into a single instanced draw, with their model matrices passed as per-instance data
+void Game::drawServants(CommandBuffer* cb)
+{
+	FrameVector<vkglTF::Model*> models;
+	for (auto servant : servants) {
+		if (servant->alive() && std::find(models.begin(), models.end(), servant->getModel()) == models.end()) {
+			models.push_back(servant->getModel());
+		}
+	}
+	if (models.empty()) {
+		return;
+	}
+	cb->bindPipeline(servantPipeline);
+	cb->bindDescriptorSets(servantPipelineLayout, { renderer->descriptorSets.camera, renderer->descriptorSets.transforms }, 0, { 0 });
+	for (auto model : models) {
+		uint32_t instanceCount = 0;
+		for (auto servant : servants) {
+			if (servant->alive() && servant->getModel() == model) {
+				instanceCount++;
+			}
+		}
+		VkDeviceSize offset;
+		glm::mat4* instances = renderer->instanceBuffer->allocate<glm::mat4>(instanceCount, offset);
+		if (!instances) {
+			std::cerr << "Instance buffer is full, skipping " + std::to_string(instanceCount) + " servants\n";
+			continue;
+		}
+		for (auto servant : servants) {
+			if (servant->alive() && servant->getModel() == model) {
+				*instances++ = servant->transform;
+			}
 		}
-		projectilesUbo.copyTo(uniformdata.data(), uniformdata.size() * sizeof(glm::vec4));
+		cb->bindVertexBuffer(renderer->instanceBuffer->buffer, 1, offset);
+		model->draw(cb->handle, servantPipelineLayout->handle, 0, instanceCount);
 	}
 }
 
@@ -259,18 +338,18 @@ void Game::spawnPlayer()
 {
 	glm::vec2 spawnPosition = glm::vec2(0.0f);
 	// Player spawns at random good portal
-	std::vector<Cell> spawnPoints;
+	FrameVector<Cell*> spawnPoints;
 	for (uint32_t x = 0; x < playingField->width; x++) {
 		for (uint32_t y = 0; y < playingField->height; y++) {
 			Cell& cell = playingField->cells[x][y];
 			if (cell.sporeType == SporeType::Good_Portal) {
-				spawnPoints.push_back(cell);
+				spawnPoints.push_back(&cell);
 			}
 		}
 	}
 	if (!spawnPoints.empty()) {
 		int32_t index = randomInt(spawnPoints.size());
-		spawnPosition = spawnPoints[index].gridPos;
+		spawnPosition = spawnPoints[index]->gridPos;
 		std::clog << "Spawning player at " << spawnPosition.x << " / " << spawnPosition.y << std::endl;
 	}
 	else {
@@ -283,18 +362,18 @@ void Game::spawnGuardian()
 {
 	glm::vec2 spawnPosition = glm::vec2(0.0f);
 	// Guardian spawns at random evil portal
-	std::vector<Cell> spawnPoints;
+	FrameVector<Cell*> spawnPoints;
 	for (uint32_t x = 0; x < playingField->width; x++) {
 		for (uint32_t y = 0; y < playingField->height; y++) {
 			Cell& cell = playingField->cells[x][y];
 			if (cell.sporeType == SporeType::Evil_Portal) {
-				spawnPoints.push_back(cell);
+				spawnPoints.push_back(&cell);
 			}
 		}
 	}
 	if (!spawnPoints.empty()) {
 		int32_t index = randomInt(spawnPoints.size());
-		spawnPosition = spawnPoints[index].gridPos;
+		spawnPosition = spawnPoints[index]->gridPos;
 		std::clog << "Spawning guardian at " << spawnPosition.x << " / " << spawnPosition.y << std::endl;
 	}
 	else {
@@ -7,12 +7,15 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <array>
 
 #include "Renderer/RenderObject.h"
 #include "Renderer/DescriptorSet.h"
 #include "Renderer/LightSource.h"
 
 #include "Utils.h"
+#include "FrameAllocator.h"
 #include "GameState.h"
 #include "GameInputListener.h"
 #include "PlayingField.h"
@@ -37,9 +40,17 @@ public:
 	Player* player;
 	Guardian* guardian;
 	std::vector<Servant*> servants;
-	DescriptorSet* descriptorSetProjectiles;
+	DescriptorSet* descriptorSetProjectiles = nullptr;
 	bool paused = false;
-	Buffer projectilesUbo;
+	// Positions of all alive projectiles, compacted by type each frame
+	Buffer projectilesSsbo;
+	vkglTF::Model* projectileModel = nullptr;
+	vkglTF::Model* portalSpawnerModel = nullptr;
+	// Looked up once in prepareGPUResources instead of by name every frame
+	Pipeline* projectilePipeline = nullptr;
+	PipelineLayout* projectilePipelineLayout = nullptr;
+	Pipeline* servantPipeline = nullptr;
+	PipelineLayout* servantPipelineLayout = nullptr;
 	LightSource getPhaseLight();
 	~Game();
 	void spawnTrigger();
@@ -47,6 +58,8 @@ public:
 	void updateProjectiles(float dT);
 	void prepareGPUResources();
 	void updateGPUResources();
+	void drawServants(CommandBuffer* cb);
+	void drawProjectiles(CommandBuffer* cb);
 	void spawnPlayer();
 	void spawnGuardian();
 	void spawnServants();
@@ -0,0 +1,439 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "GameLoop.h"
+
+#include <array>
+#include <chrono>
+
+#include "Renderer/AssetManager.h"
+
+#include "Player.h"
+#include "Guardian.h"
+#include "Servant.h"
+#include "PlayingField.h"
+#include "TarotDeck.h"
+
+#include "Game.h"
+#include "GameState.h"
+#include "GameInput.h"
+
+#include "DebugUI.h"
+#include "UI/GameUI.h"
+#include "AllocationTracker.h"
+#include "FrameAllocator.h"
+
+VulkanRenderer* renderer;
+
+namespace
+{
+	Game* game;
+	Player* player;
+	Guardian* guardian;
+	TarotDeck* tarotDeck;
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> tStart = std::chrono::high_resolution_clock::now();
+	std::chrono::time_point<std::chrono::high_resolution_clock> lastTimestamp;
+	std::chrono::duration<float, std::milli> tDelta;
+	uint32_t frameCounter = 0;
+	bool minimized = false;
+
+	// Spore types in draw order and the models they are drawn with
+	constexpr std::array<SporeType, 5> sporeTypes = { SporeType::Good, SporeType::Good_Portal, SporeType::Evil, SporeType::Evil_Portal, SporeType::Evil_Dead };
+	constexpr std::array<const char*, 5> sporeModelNames = { "spore_good", "portal_good", "spore_evil", "portal_evil", "spore_evil_dead" };
+
+	// Looked up once in prepareGPUResources instead of by name every frame
+	struct {
+		RenderPass* offscreenRenderPass = nullptr;
+		PipelineLayout* pipelineLayout = nullptr;
+		Pipeline* backdropPipeline = nullptr;
+		Pipeline* sporePipeline = nullptr;
+		Pipeline* compositionPipeline = nullptr;
+		vkglTF::Model* plane = nullptr;
+		vkglTF::Model* faceSun = nullptr;
+		vkglTF::Model* faceMoon = nullptr;
+		std::array<vkglTF::Model*, sporeTypes.size()> sporeModels{};
+	} scene;
+
+	// Allocation zones of the frame, registered once so entering a zone doesn't look up its name
+	const uint32_t debugUIZone = AllocationTracker::registerZone("debug ui");
+	const uint32_t commandBufferZone = AllocationTracker::registerZone("command buffer");
+	const uint32_t gpuUpdateZone = AllocationTracker::registerZone("game gpu update");
+	const uint32_t updateZone = AllocationTracker::registerZone("game update");
+	const uint32_t gameUIZone = AllocationTracker::registerZone("game ui");
+}
+
+void init()
+{
+	frameAllocator = new FrameAllocator(1024 * 1024);
+
+	debugUI = new DebugUI();
+	debugUI->setRenderer(renderer);
+
+	gameUI = new UI::GameUI();
+	gameUI->setRenderer(renderer);
+	gameUI->addFont("Raleway-Bold");
+	gameUI->setfont("Raleway-Bold");
+	gameUI->addTextElement("player_score", "0500", glm::vec3(0.0f), UI::TextAlignment::TopLeft, glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
+	gameUI->addTextElement("pause", "Paused", glm::vec3(0.5f, 0.5f, 0.0f), UI::TextAlignment::Center, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f), false);
+	gameUI->addTextElement("loading", "Loading", glm::vec3(0.5f, 0.5f, 0.0f), UI::TextAlignment::Center, glm::vec4(1.0f), false);
+
+	game = new Game();
+	game->setRenderer(renderer);
+	game->setView(View::InGame, false);
+	gameState = new GameState();
+	// Visual bounding box
+	// @todo: Different aspect ratios
+	const float dim = 12.5f;
+	const float ar = (float)renderer->width / (float)renderer->height;
+	BoundingBox boundingBox(-dim * ar, dim * ar, -dim, dim);
+	gameState->boundingBox = boundingBox;
+
+	playingField = new PlayingField();
+	playingField->setRenderer(renderer);
+	playingField->generate(35, 19);
+
+	player = new Player();
+	player->setRenderer(renderer);
+
+	guardian = new Guardian();
+	guardian->setRenderer(renderer);
+	game->servants.resize(8);
+	for (auto& servant : game->servants) {
+		servant = new Servant();
+		servant->setRenderer(renderer);
+	}
+
+	tarotDeck = new TarotDeck();
+	tarotDeck->setRenderer(renderer);
+
+	input = new GameInput();
+	input->addInputListener(game);
+	input->addInputListener(player);
+
+	game->player = player;
+	game->guardian = guardian;
+	game->tarotDeck = tarotDeck;
+
+	std::srand((int)std::time(nullptr));
+
+	renderer->camera.type = Camera::CameraType::firstperson;
+	renderer->camera.position = { 0.0f, 20.0f, 0.0f };
+	renderer->camera.setRotation(glm::vec3(-90.0f, 0.0f, 0.0f));
+	renderer->camera.setOrtho(boundingBox.left, boundingBox.right, boundingBox.top, boundingBox.bottom, -512.0f, 512.0f);
+
+	gameState->windowSize = glm::vec2(renderer->width, renderer->height);
+
+	debugUI->player = player;
+	debugUI->guardian = guardian;
+	debugUI->tarotDeck = tarotDeck;
+
+	game->spawnPlayer();
+	game->spawnGuardian();
+	game->spawnServants();
+
+	// The font atlas upload has to be acquired by the graphics queue before the loading frames sample it
+	renderer->device->uploadManager->flush(true);
+}
+
+void buildCommandBuffer()
+{
+	CommandBuffer* cb = renderer->commandBuffer;
+	cb->begin();
+
+	// Fill render-targets (offscreen)
+	cb->beginRenderPass(scene.offscreenRenderPass, renderer->offscreenPass.frameBuffer);
+	cb->setViewport(0.0f, 0.0f, (float)renderer->offscreenPass.width, (float)renderer->offscreenPass.height, 0.0f, 1.0f);
+	cb->setScissor(0, 0, renderer->offscreenPass.width, renderer->offscreenPass.height);
+
+	// All models share the same geometry buffers, so these only need to be bound once
+	assetManager->meshBuffer->bind(cb->handle);
+
+	cb->bindPipeline(scene.backdropPipeline);
+	cb->bindDescriptorSets(scene.pipelineLayout, { renderer->descriptorSets.camera, renderer->descriptorSets.transforms }, 0, { renderer->transformBuffer->getOffset(player->transformSlot) });
+	scene.plane->draw(cb->handle, scene.pipelineLayout->handle);
+
+	// Face
+	// @todo: Separate pipeline
+	cb->bindPipeline(scene.backdropPipeline);
+	switch (gameState->phase) {
+	case Phase::Day:
+	{
+		scene.faceSun->draw(cb->handle, scene.pipelineLayout->handle);
+		break;
+	}
+	case Phase::Night:
+	{
+		scene.faceMoon->draw(cb->handle, scene.pipelineLayout->handle);
+		break;
+	}
+	}
+
+	// Playing field
+	cb->bindVertexBuffer(playingField->instanceBuffer, 1);
+	cb->bindPipeline(scene.sporePipeline);
+
+	for (size_t i = 0; i < sporeTypes.size(); i++) {
+		// @todo: store model referene in cell upon change
+		vkglTF::Model* model = scene.sporeModels[i];
+		for (uint32_t x = 0; x < playingField->width; x++) {
+			for (uint32_t y = 0; y < playingField->height; y++) {
+				Cell* cell = &playingField->cells[x][y];
+				if (cell->sporeType == sporeTypes[i]) {
+					const uint32_t idx = (x * playingField->height) + y;
+					model->draw(cb->handle, scene.pipelineLayout->handle, idx);
+				}
+			}
+		}
+	}
+
+	//@todo: Virtual function in RenderObject class, register, Renderobjects and draw in loop
+	tarotDeck->draw(cb);
+	player->draw(cb);
+	guardian->draw(cb);
+	game->drawServants(cb);
+
+	// Projectiles
+	game->drawProjectiles(cb);
+
+	cb->endRenderPass();
+
+	// Deferred composition
+	cb->beginRenderPass(renderer->deferredComposition.renderPass, renderer->frameBuffers[renderer->currentBuffer]);
+	cb->setViewport(0.0f, 0.0f, (float)renderer->width, (float)renderer->height, 0.0f, 1.0f);
+	cb->setScissor(0, 0, renderer->width, renderer->height);
+	cb->bindDescriptorSets(renderer->deferredComposition.pipelineLayout, { renderer->deferredComposition.descriptorSet }, 0);
+	cb->bindPipeline(scene.compositionPipeline);
+	cb->draw(6, 1, 0, 0);
+	if (renderer->settings.debugoverlay) {
+		debugUI->draw(cb);
+	}
+	gameUI->draw(cb);
+	cb->endRenderPass();
+
+	cb->end();
+}
+
+// Only renders the game UI, used while assets are loaded in the background
+void buildLoadingCommandBuffer()
+{
+	CommandBuffer* cb = renderer->commandBuffer;
+	cb->begin();
+	cb->beginRenderPass(renderer->deferredComposition.renderPass, renderer->frameBuffers[renderer->currentBuffer]);
+	cb->setViewport(0.0f, 0.0f, (float)renderer->width, (float)renderer->height, 0.0f, 1.0f);
+	cb->setScissor(0, 0, renderer->width, renderer->height);
+	gameUI->draw(cb);
+	cb->endRenderPass();
+	cb->end();
+}
+
+void updateLights()
+{
+	renderer->lightSources.numLights = 0;
+	renderer->lightSources.viewPos = glm::vec4(renderer->camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+	renderer->addLight(player->getLightSource());
+	renderer->addLight(guardian->getLightSource());
+	renderer->addLight(game->getPhaseLight());
+	for (auto projectile : gameState->projectiles) {
+		if (projectile.alive) {
+			renderer->addLight(projectile.getLightSource());
+		}
+	}
+	for (uint32_t x = 0; x < playingField->width; x++) {
+		for (uint32_t y = 0; y < playingField->height; y++) {
+			Cell& cell = playingField->cells[x][y];
+			if (cell.hasLightSource()) {
+				renderer->addLight(cell.getLightSource());
+			}
+		}
+	}
+	renderer->deferredComposition.lightsBuffer.copyTo(&renderer->lightSources, sizeof(renderer->lightSources));
+}
+
+bool loadAssets()
+{
+	assetManager->addModelsFolderAsync("scenes");
+	assetManager->addTexturesFolderAsync("textures");
+
+	// Keep presenting frames while assets are loaded in the background
+	bool quit = false;
+	gameUI->prepareGPUResources();
+	gameUI->getTextElement("player_score")->visible = false;
+	gameUI->getTextElement("loading")->visible = true;
+	while (assetManager->isLoading() && !quit) {
+		SDL_Event sdlEvent;
+		while (SDL_PollEvent(&sdlEvent)) {
+			if (sdlEvent.type == SDL_QUIT) {
+				quit = true;
+			}
+		}
+		gameUI->getTextElement("loading")->text = "Loading " + std::to_string((int)(assetManager->getLoadingProgress() * 100.0f)) + "%";
+		gameUI->updateGPUResources();
+		renderer->waitSync();
+		buildLoadingCommandBuffer();
+		renderer->submitFrame();
+	}
+	gameUI->getTextElement("player_score")->visible = true;
+	gameUI->getTextElement("loading")->visible = false;
+	std::clog << "Startup uploads: " << renderer->device->uploadManager->stats.submits << " batched submits, " << renderer->device->uploadManager->stats.waits << " blocking waits, " << renderer->device->blockingSubmitCount << " blocking single submits" << std::endl;
+	std::clog << "Model loading: " << assetManager->modelLoadStats.bakedCount << " baked (" << assetManager->modelLoadStats.bakedTime << " ms), " << assetManager->modelLoadStats.glTFCount << " glTF (" << assetManager->modelLoadStats.glTFTime << " ms)" << std::endl;
+	{
+		// Vertex memory and per vertex fetch size compared to the full vertex layout
+		const auto& stats = assetManager->modelLoadStats;
+		const size_t fullVertexBytes = (size_t)stats.vertexCount * sizeof(vkglTF::Model::Vertex);
+		std::clog << "Vertex data: " << stats.vertexCount << " vertices, " << stats.vertexBytes / 1024 << " KB (" << fullVertexBytes / 1024 << " KB with full vertices, " << (fullVertexBytes - stats.vertexBytes) / 1024 << " KB saved), fetch " << sizeof(vkglTF::Model::CompactVertex) << " instead of " << sizeof(vkglTF::Model::Vertex) << " bytes per static vertex" << std::endl;
+		std::clog << "Index data: " << stats.indexCount << " indices, " << stats.indexBytes / 1024 << " KB (" << (size_t)stats.indexCount * sizeof(uint32_t) / 1024 << " KB with 32 bit indices)" << std::endl;
+	}
+	return !quit;
+}
+
+void prepareGPUResources()
+{
+	tarotDeck->setState(TarotDeckState::Hidden);
+	guardian->setModel("guardian_black_sun");
+	for (auto& guardianservant : game->servants) {
+		guardianservant->setModel("guardian_01_servant");
+	}
+	tarotDeck->setModel("tarot_card");
+	for (const char* name : { "plane", "face_sun", "face_moon" }) {
+		renderer->checkModelVertexFormat("backdrop", name);
+	}
+	for (const char* name : sporeModelNames) {
+		renderer->checkModelVertexFormat("spore", name);
+	}
+
+	scene.offscreenRenderPass = renderer->getRenderPass("offscreen");
+	scene.pipelineLayout = renderer->getPipelineLayout("split_ubo");
+	scene.backdropPipeline = renderer->getPipeline("backdrop");
+	scene.sporePipeline = renderer->getPipeline("spore");
+	scene.compositionPipeline = renderer->getPipeline("composition");
+	scene.plane = assetManager->getModel("plane");
+	scene.faceSun = assetManager->getModel("face_sun");
+	scene.faceMoon = assetManager->getModel("face_moon");
+	for (size_t i = 0; i < sporeModelNames.size(); i++) {
+		scene.sporeModels[i] = assetManager->getModel(sporeModelNames[i]);
+	}
+
+	game->prepareGPUResources();
+	debugUI->prepareGPUResources(renderer->pipelineCache, renderer->getRenderPass("deferred_composition"));
+	// All pipelines exist now, shaders loaded after this are owned by their pipelines
+	assetManager->releaseShaderModules();
+	playingField->prepareGPUResources();
+	player->prepareGPUResources();
+	guardian->prepareGPUResources();
+	tarotDeck->prepareGPUResources();
+
+	renderer->camera.updateGPUResources();
+	player->updateGPUResources();
+	guardian->updateGPUResources();
+	for (auto& guardianservant : game->servants) {
+		guardianservant->updateGPUResources();
+	}
+	tarotDeck->updateGPUResources();
+	gameUI->updateGPUResources();
+	// Same for the debug UI font and everything else uploaded above, before the first frame uses them
+	renderer->device->uploadManager->flush(true);
+
+	tStart = std::chrono::high_resolution_clock::now();
+	lastTimestamp = std::chrono::high_resolution_clock::now();
+}
+
+bool runFrame()
+{
+	tDelta = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart);
+	tStart = std::chrono::high_resolution_clock::now();
+	SDL_Event sdlEvent;
+	while (SDL_PollEvent(&sdlEvent)) {
+		switch (sdlEvent.type) {
+		case SDL_QUIT:
+			return false;
+		case SDL_WINDOWEVENT: {
+			if (sdlEvent.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+				minimized = true;
+			}
+			if (sdlEvent.window.event == SDL_WINDOWEVENT_RESTORED) {
+				minimized = false;
+			}
+			break;
+		}
+		default:
+			input->handleInput(sdlEvent);
+		}
+	}
+
+	if (minimized) {
+		return true;
+	}
+
+	renderer->waitSync();
+	frameAllocator->reset();
+	AllocationTracker::beginFrame();
+
+	if (renderer->settings.debugoverlay) {
+		AllocationZone zone(debugUIZone);
+		debugUI->render();
+	}
+	{
+		AllocationZone zone(commandBufferZone);
+		buildCommandBuffer();
+	}
+
+	input->update();
+
+	if (!game->paused) {
+		AllocationZone zone(gpuUpdateZone);
+		// @todo: only when ingame
+		game->updateGPUResources();
+		updateLights();
+	}
+	else {
+		// @todo
+		renderer->lightSources.fade = game->fade * 0.5f;
+		renderer->lightSources.desaturate = game->paused ? 0.5f : 0.0f;
+		renderer->deferredComposition.lightsBuffer.copyTo(&renderer->lightSources, sizeof(renderer->lightSources));
+	}
+
+	renderer->submitFrame();
+
+	float timeStep = tDelta.count() / 1000.0f;
+	if (!game->paused) {
+		AllocationZone zone(updateZone);
+		playingField->update(timeStep);
+		game->update(timeStep);
+		player->update(timeStep);
+		guardian->update(timeStep);
+		tarotDeck->update(timeStep);
+	}
+	{
+		AllocationZone zone(gameUIZone);
+		gameUI->updateGPUResources();
+	}
+	frameCounter++;
+
+	float fpsTimer = (float)(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - lastTimestamp).count());
+	if (fpsTimer >= 1000.0f)
+	{
+		debugUI->timing.fps.update(static_cast<float>((float)frameCounter* (1000.0f / fpsTimer)));
+		frameCounter = 0;
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+	}
+	return true;
+}
+
+void shutdown()
+{
+	// Objects free their descriptor sets on deletion, which must not be in use anymore
+	vkDeviceWaitIdle(renderer->device->handle);
+	delete playingField;
+	delete game;
+	delete player;
+	delete guardian;
+	delete debugUI;
+	delete gameUI;
+	delete renderer;
+	delete input;
+	delete frameAllocator;
+}
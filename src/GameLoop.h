@@ -0,0 +1,24 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include "Renderer/VulkanRenderer.h"
+
+// Game setup and the per-frame loop, shared by the game executable and the steady state allocation test (Tests/AllocationTest.cpp)
+// The asset manager and the renderer have to be created before calling init
+
+extern VulkanRenderer* renderer;
+
+void init();
+// Presents loading frames until the background asset loads are done, returns false if the window was closed meanwhile
+bool loadAssets();
+// Sets up everything that depends on loaded assets, call once after loadAssets
+void prepareGPUResources();
+// Handles window events and renders a single frame, returns false once the window has been closed
+bool runFrame();
+// Waits for the device and deletes all game objects, the renderer included
+void shutdown();
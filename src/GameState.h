@@ -15,7 +15,7 @@ enum class Phase { Day, Night };
 class GameStateValues 
 {
 public:
-	const int maxNumProjectiles = 512;
+	const int maxNumProjectiles = 8192;
 	float playingFieldDeadzone = 4.5f;
 	float maxSporeSize = 0.75f;
 	float maxGrowthDistanceToPortal = 5.0f;
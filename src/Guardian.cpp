@@ -14,6 +14,11 @@ Guardian::Guardian()
     direction = glm::vec2(0.0f);
 }
 
+Guardian::~Guardian()
+{
+    renderer->transformBuffer->free(transformSlot);
+}
+
 LightSource Guardian::getLightSource()
 {
     // @todo: Change with state like HP and bonuses
@@ -26,25 +31,23 @@ LightSource Guardian::getLightSource()
 
 void Guardian::prepareGPUResources()
 {
-    VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &ubo, sizeof(glm::mat4)));
-    descriptorSet = new DescriptorSet(renderer->device->handle);
-    descriptorSet->setPool(renderer->descriptorPool);
-    descriptorSet->addLayout(renderer->getDescriptorSetLayout("single_ubo"));
-    descriptorSet->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &ubo.descriptor);
-    descriptorSet->create();
+    transformSlot = renderer->transformBuffer->allocate();
+    pipeline = renderer->getPipeline("player");
+    pipelineLayout = renderer->getPipelineLayout("split_ubo");
 }
 
 void Guardian::updateGPUResources()
 {
     glm::mat4 mat = glm::translate(glm::mat4(1.0f), position);
     mat = glm::rotate(mat, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-    ubo.copyTo(&mat, sizeof(mat));
+    renderer->transformBuffer->set(transformSlot, mat);
 }
 
 void Guardian::setModel(std::string name)
 {
     model = assetManager->getModel(name);
     assert(model);
+    renderer->checkModelVertexFormat("player", name);
     size.x = model->dimensions.max.x - model->dimensions.min.x;
     size.y = model->dimensions.max.z - model->dimensions.min.z;
 }
@@ -71,9 +74,9 @@ void Guardian::draw(CommandBuffer* cb)
     assert(model);
     //@todo: Distinct pipeline
     if (alive()) {
-        cb->bindPipeline(renderer->getPipeline("player"));
-        cb->bindDescriptorSets(renderer->getPipelineLayout("split_ubo"), { renderer->descriptorSets.camera, descriptorSet }, 0);
-        model->draw(cb->handle, renderer->getPipelineLayout("split_ubo")->handle);
+        cb->bindPipeline(pipeline);
+        cb->bindDescriptorSets(pipelineLayout, { renderer->descriptorSets.camera, renderer->descriptorSets.transforms }, 0, { renderer->transformBuffer->getOffset(transformSlot) });
+        model->draw(cb->handle, pipelineLayout->handle);
     }
 }
 
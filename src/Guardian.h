@@ -22,9 +22,12 @@ enum class GuardianState {
 class Guardian: public RenderObject
 {
 private:
-	Buffer ubo;
-	DescriptorSet* descriptorSet;
+	// Slot of the model matrix in the renderer's transform buffer
+	uint32_t transformSlot = 0;
 	vkglTF::Model* model;
+	// Looked up once in prepareGPUResources instead of by name every frame
+	Pipeline* pipeline = nullptr;
+	PipelineLayout* pipelineLayout = nullptr;
 public:
 	float zIndex = 255.0f;
 	glm::vec3 position;
@@ -34,6 +37,7 @@ public:
 	float health;
 	GuardianState state = GuardianState::Default;
 	Guardian();
+	~Guardian();
 	LightSource getLightSource();
 	void prepareGPUResources();
 	void updateGPUResources();
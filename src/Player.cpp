@@ -12,6 +12,11 @@ Player::Player() {
 	rotation = glm::vec2(0.0f);
 }
 
+Player::~Player()
+{
+	renderer->transformBuffer->free(transformSlot);
+}
+
 LightSource Player::getLightSource()
 {
 	// @todo: Change with player state like HP and bonuses
@@ -86,18 +91,19 @@ void Player::pickupObjects()
 
 void Player::prepareGPUResources()
 {
-	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &ubo, sizeof(glm::mat4)));
-	descriptorSet = new DescriptorSet(renderer->device->handle);
-	descriptorSet->setPool(renderer->descriptorPool);
-	descriptorSet->addLayout(renderer->getDescriptorSetLayout("single_ubo"));
-	descriptorSet->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &ubo.descriptor);
-	descriptorSet->create();
+	transformSlot = renderer->transformBuffer->allocate();
+	model = assetManager->getModel("player_star");
+	portalSpawnerModel = assetManager->getModel("portal_spawner_good");
+	pipeline = renderer->getPipeline("player");
+	pipelineLayout = renderer->getPipelineLayout("split_ubo");
+	renderer->checkModelVertexFormat("player", "player_star");
+	renderer->checkModelVertexFormat("player", "portal_spawner_good");
 }
 
 void Player::updateGPUResources() {
 	glm::mat4 mat = glm::translate(glm::mat4(1.0f), position);
 	mat = glm::rotate(mat, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-	ubo.copyTo(&mat, sizeof(mat));
+	renderer->transformBuffer->set(transformSlot, mat);
 }
 
 void Player::update(float dT) {
@@ -160,11 +166,11 @@ void Player::update(float dT) {
 
 void Player::draw(CommandBuffer* cb)
 {
-	cb->bindPipeline(renderer->getPipeline("player"));
-	cb->bindDescriptorSets(renderer->getPipelineLayout("split_ubo"), { renderer->descriptorSets.camera, descriptorSet }, 0);
-	assetManager->getModel("player_star")->draw(cb->handle, renderer->getPipelineLayout("split_ubo")->handle);
+	cb->bindPipeline(pipeline);
+	cb->bindDescriptorSets(pipelineLayout, { renderer->descriptorSets.camera, renderer->descriptorSets.transforms }, 0, { renderer->transformBuffer->getOffset(transformSlot) });
+	model->draw(cb->handle, pipelineLayout->handle);
 	if (state == PlayerState::Carries_Portal_Spawner) {
-		assetManager->getModel("portal_spawner_good")->draw(cb->handle, renderer->getPipelineLayout("split_ubo")->handle);
+		portalSpawnerModel->draw(cb->handle, pipelineLayout->handle);
 	}
 }
 
@@ -27,14 +27,19 @@ class Player: public GameInputListener, public RenderObject
 {
 private:
 	float firingCooldown = 0.0f;
+	// Looked up once in prepareGPUResources instead of by name every frame
+	vkglTF::Model* model = nullptr;
+	vkglTF::Model* portalSpawnerModel = nullptr;
+	Pipeline* pipeline = nullptr;
+	PipelineLayout* pipelineLayout = nullptr;
 	void onKeyboardStateUpdated(const Uint8* keyboardState);
 	void onMouseButtonClick(uint32_t button);
 	void fireProjectile();
 	void pickupObjects();
 public:
 	float zIndex = 256.0f;
-	Buffer ubo;
-	DescriptorSet* descriptorSet;
+	// Slot of the model matrix in the renderer's transform buffer
+	uint32_t transformSlot = 0;
 	glm::vec3 position;
 	float health;
 	PlayerState state = PlayerState::Default;
@@ -50,6 +55,7 @@ public:
 		bool down = false;
 	} keys;
 	Player();
+	~Player();
 	LightSource getLightSource();
 	void prepareGPUResources();
 	void updateGPUResources();
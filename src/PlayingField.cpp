@@ -305,9 +305,9 @@ void PlayingField::prepareGPUResources()
 
 	// @todo: staging, ring-buffer, etc.
 	const uint32_t dim = width * height;
-	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &instanceBuffer, sizeof(InstanceData) * dim));
+	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &instanceBuffer, sizeof(InstanceData) * dim, nullptr, MemoryCategory::Geometry));
 	// Init instance data
-	std::vector<InstanceData> instanceData(width * height);
+	instanceData.resize(dim);
 	for (uint32_t x = 0; x < width; x++) {
 		for (uint32_t y = 0; y < height; y++) {
 			const uint32_t idx = (x * height) + y;
@@ -323,13 +323,17 @@ void PlayingField::prepareGPUResources()
 void PlayingField::updateGPUResources()
 {
 	bool updateBuffer = false;
-	std::vector<InstanceData> instanceData(width * height);
+	if (instanceData.size() != width * height) {
+		instanceData.resize(width * height);
+		updateBuffer = true;
+	}
 	for (uint32_t x = 0; x < width; x++) {
 		for (uint32_t y = 0; y < height; y++) {
 			const uint32_t idx = (x * height) + y;
-			if (cells[x][y].sporeSize != instanceData[idx].scale) {
-				Cell& cell = cells[x][y];
-				instanceData[idx].pos = glm::vec3(cell.gridPos.x + cell.rndOffset.x, 1.0f - cell.zIndex, cell.gridPos.y + cell.rndOffset.y);
+			Cell& cell = cells[x][y];
+			const glm::vec3 pos = glm::vec3(cell.gridPos.x + cell.rndOffset.x, 1.0f - cell.zIndex, cell.gridPos.y + cell.rndOffset.y);
+			if ((cell.sporeSize != instanceData[idx].scale) || (pos != instanceData[idx].pos)) {
+				instanceData[idx].pos = pos;
 				instanceData[idx].scale = cell.sporeSize;
 				//if (cell.sporeType == SporeType::Good_Portal) {
 				//	instanceData[idx].pos.y = -2.0f;
@@ -23,6 +23,8 @@ private:
 		glm::vec3 pos;
 		float scale;
 	};
+	// Host copy of the instance buffer, kept across frames so only changes need to be detected
+	std::vector<InstanceData> instanceData;
 	void updatePortal(Cell* portal, float dT);
 	void getCellsAtDistance(glm::ivec2 pos, uint32_t distance, Cell* cells[], uint32_t& count);
 public:
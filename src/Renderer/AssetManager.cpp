@@ -5,6 +5,7 @@
  */
 
 #include "AssetManager.h"
+#include "UploadManager.h"
 
 AssetManager* assetManager = nullptr;
 
@@ -17,31 +18,198 @@ void AssetManager::addModelsFolder(std::string folder)
 			continue;
 		}
 		vkglTF::Model* model = new vkglTF::Model();
-		model->loadFromFile(file.path().string(), device, transferQueue);
-		models[name] = model;
+		model->meshBuffer = meshBuffer;
+		model->materialBuffer = materialBuffer;
+		model->jointBuffer = jointBuffer;
+		model->loadFromFile(file.path().string(), device, transferQueue, 1.0f, forceModelBake);
+		{
+			std::lock_guard<std::mutex> lock(assetsMutex);
+			models[name] = model;
+		}
 		std::clog << "Model \"" << name << "\" added from \"" << folder << "\"" << std::endl;
 	}
 }
 
-vkglTF::Model* AssetManager::getModel(std::string name)
+// Returns nullptr if the model is not (yet) resident
+vkglTF::Model* AssetManager::getModel(const std::string& name)
 {
-	return models[name];
+	std::lock_guard<std::mutex> lock(assetsMutex);
+	auto model = models.find(name);
+	return model != models.end() ? model->second : nullptr;
 }
 
 void AssetManager::addTexturesFolder(std::string folder)
 {
 	for (const auto& file : std::filesystem::directory_iterator(assetPath + folder)) {
+		// Skips the texture cache folder
+		if (file.path().extension().string() != ".ktx") {
+			continue;
+		}
 		const std::string name = file.path().stem().string();
 		Texture2D* texture = new Texture2D();
-		texture->loadFromFile(file.path().string(), device, transferQueue);
-		textures[name] = texture;
+		ktxTexture* ktxTexture;
+		if (texture->loadKTXFile(file.path().string(), &ktxTexture) != KTX_SUCCESS) {
+			std::cerr << "Error: Could not load texture file \"" + file.path().string() + "\"\n";
+			delete texture;
+			continue;
+		}
+		Texture::compressKTXTexture(&ktxTexture, device, file.path().string());
+		texture->loadFromKTXTexture(ktxTexture, device, transferQueue);
+		{
+			std::lock_guard<std::mutex> lock(assetsMutex);
+			textures[name] = texture;
+		}
 		std::clog << "Texture \"" << name << "\" added from \"" << folder << "\"" << std::endl;
 	}
 }
 
+// Returns nullptr if the texture is not (yet) resident
 Texture* AssetManager::getTexture(std::string name)
 {
-	return textures[name];
+	std::lock_guard<std::mutex> lock(assetsMutex);
+	auto texture = textures.find(name);
+	return texture != textures.end() ? texture->second : nullptr;
+}
+
+void AssetManager::startAsyncLoading()
+{
+	if (!loaderQueue) {
+		loaderQueue = new JobQueue(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+		uploadQueue = new JobQueue(1);
+	}
+}
+
+// Loads a model in the background, the returned future resolves once the model is resident (or with nullptr if loading failed)
+// An up to date baked model file is mapped and uploaded directly, otherwise the glTF file is parsed
+// Baking is an offline step (-bakemodels), models are never baked while the game is running
+std::shared_future<vkglTF::Model*> AssetManager::loadModelAsync(std::string name, std::string filename)
+{
+	startAsyncLoading();
+	auto promise = std::make_shared<std::promise<vkglTF::Model*>>();
+	std::shared_future<vkglTF::Model*> future = promise->get_future().share();
+	assetsQueued++;
+	loaderQueue->push([this, name, filename, promise]() {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		auto bakedFile = std::make_shared<MappedFile>();
+		std::shared_ptr<tinygltf::Model> gltfModel;
+		if (forceModelBake || !vkglTF::Model::openBakedFile(vkglTF::Model::getBakedFilename(filename), filename, *bakedFile)) {
+			std::clog << "Model \"" + name + "\" has no up to date baked file, loading glTF (run with -bakemodels to bake)\n";
+			gltfModel = std::make_shared<tinygltf::Model>();
+			if (!vkglTF::Model::loadglTFFile(filename, *gltfModel, Texture::getCompressionFormat(device))) {
+				assetsFinished++;
+				promise->set_value(nullptr);
+				return;
+			}
+		}
+		const double readTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		uploadQueue->push([this, name, filename, bakedFile, gltfModel, readTime, promise]() {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			vkglTF::Model* model = new vkglTF::Model();
+			model->meshBuffer = meshBuffer;
+			model->materialBuffer = materialBuffer;
+			model->jointBuffer = jointBuffer;
+			if (gltfModel) {
+				model->loadFromglTFModel(*gltfModel, device, transferQueue, 1.0f, filename, false);
+			}
+			else {
+				model->loadFromBakedFile(*bakedFile, device, transferQueue);
+				bakedFile->close();
+			}
+			const double loadTime = readTime + std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			const bool baked = !gltfModel;
+			// Only publish once the uploads have finished
+			device->uploadManager->onComplete([this, name, model, baked, loadTime, promise]() {
+				{
+					std::lock_guard<std::mutex> lock(assetsMutex);
+					models[name] = model;
+					modelLoadStats.vertexCount += model->vertexCount;
+					modelLoadStats.vertexBytes += (size_t)model->vertexCount * vkglTF::Model::getVertexStride(model->vertexFormat);
+					modelLoadStats.indexCount += model->indexCount;
+					modelLoadStats.indexBytes += (size_t)model->indexCount * vkglTF::Model::getIndexSize(model->indexType);
+					if (baked) {
+						modelLoadStats.bakedCount++;
+						modelLoadStats.bakedTime += loadTime;
+					}
+					else {
+						modelLoadStats.glTFCount++;
+						modelLoadStats.glTFTime += loadTime;
+					}
+				}
+				std::clog << "Model \"" + name + "\" is resident (" + (baked ? "baked" : "glTF") + ", " + std::to_string(loadTime) + " ms)\n";
+				assetsFinished++;
+				promise->set_value(model);
+			});
+		});
+	});
+	return future;
+}
+
+// Loads a KTX texture in the background, the returned future resolves once the texture is resident (or with nullptr if loading failed)
+std::shared_future<Texture*> AssetManager::loadTextureAsync(std::string name, std::string filename)
+{
+	startAsyncLoading();
+	auto promise = std::make_shared<std::promise<Texture*>>();
+	std::shared_future<Texture*> future = promise->get_future().share();
+	assetsQueued++;
+	loaderQueue->push([this, name, filename, promise]() {
+		Texture2D* texture = new Texture2D();
+		ktxTexture* ktxTexture;
+		if (texture->loadKTXFile(filename, &ktxTexture) != KTX_SUCCESS) {
+			std::cerr << "Error: Could not load texture file \"" + filename + "\"\n";
+			delete texture;
+			assetsFinished++;
+			promise->set_value(nullptr);
+			return;
+		}
+		// Block compression is done here, so it runs on the loader threads
+		Texture::compressKTXTexture(&ktxTexture, device, filename);
+		uploadQueue->push([this, name, texture, ktxTexture, promise]() {
+			texture->loadFromKTXTexture(ktxTexture, device, transferQueue);
+			// Only publish once the uploads have finished
+			device->uploadManager->onComplete([this, name, texture, promise]() {
+				{
+					std::lock_guard<std::mutex> lock(assetsMutex);
+					textures[name] = texture;
+				}
+				std::clog << "Texture \"" + name + "\" is resident\n";
+				assetsFinished++;
+				promise->set_value(texture);
+			});
+		});
+	});
+	return future;
+}
+
+void AssetManager::addModelsFolderAsync(std::string folder)
+{
+	for (const auto& file : std::filesystem::directory_iterator(assetPath + folder)) {
+		if (file.path().extension().string() == ".gltf") {
+			loadModelAsync(file.path().stem().string(), file.path().string());
+		}
+	}
+}
+
+void AssetManager::addTexturesFolderAsync(std::string folder)
+{
+	for (const auto& file : std::filesystem::directory_iterator(assetPath + folder)) {
+		// Skips the texture cache folder
+		if (file.path().extension().string() != ".ktx") {
+			continue;
+		}
+		loadTextureAsync(file.path().stem().string(), file.path().string());
+	}
+}
+
+bool AssetManager::isLoading()
+{
+	return assetsFinished < assetsQueued;
+}
+
+// Returns the progress of all asynchronous loads queued so far in the range 0..1
+float AssetManager::getLoadingProgress()
+{
+	const uint32_t queued = assetsQueued;
+	return queued > 0 ? (float)assetsFinished / (float)queued : 1.0f;
 }
 
 AssetManager::AssetManager()
@@ -57,9 +225,30 @@ AssetManager::AssetManager()
 	}
 }
 
+AssetManager::~AssetManager()
+{
+	// Deleting the queues finishes pending jobs, loader threads need to be done before the upload thread goes away
+	delete loaderQueue;
+	delete uploadQueue;
+	releaseShaderModules();
+	delete meshBuffer;
+	delete materialBuffer;
+	delete jointBuffer;
+}
+
 void AssetManager::setDevice(Device* device)
 {
 	this->device = device;
+	// 1M compact vertices (16 MB) and 4M 16 bit indices (8 MB)
+	meshBuffer = new MeshBuffer(device, sizeof(vkglTF::Model::CompactVertex), 1024 * 1024, 4 * 1024 * 1024, VK_INDEX_TYPE_UINT16);
+	// The first material is the default material used by models that could not get space in the buffer
+	materialBuffer = new MaterialBuffer(device, sizeof(vkglTF::ShaderMaterial), 4096);
+	uint32_t defaultMaterial;
+	materialBuffer->allocate(1, defaultMaterial);
+	const vkglTF::ShaderMaterial defaultShaderMaterial = vkglTF::Material().getShaderMaterial();
+	materialBuffer->upload(defaultMaterial, &defaultShaderMaterial, 1);
+	// 16k joint matrices (1 MB), only one frame is in flight (see VulkanRenderer::waitSync)
+	jointBuffer = new JointBuffer(device, 16 * 1024, 1);
 }
 
 void AssetManager::setTransferQueue(VkQueue queue)
@@ -67,32 +256,82 @@ void AssetManager::setTransferQueue(VkQueue queue)
 	this->transferQueue = queue;
 }
 
-VkShaderModule AssetManager::loadShaderShaderModule(std::string filename)
+// 64-bit FNV-1a
+uint64_t hashShaderCode(const char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Returns a (cached) shader module for the given SPIR-V file
+// Can be called from multiple threads, cached modules stay alive until releaseShaderModules is called
+// Once the cache has been released, a new module is created for every call and cached is false, the caller then owns the module
+VkShaderModule AssetManager::loadShaderShaderModule(std::string filename, bool& cached)
 {
-	std::ifstream is(assetPath + filename, std::ios::binary | std::ios::in | std::ios::ate);
-	if (is.is_open())
 	{
-		size_t size = is.tellg();
-		is.seekg(0, std::ios::beg);
-		char* shaderCode = new char[size];
-		is.read(shaderCode, size);
-		is.close();
-		assert(size > 0);
-		VkShaderModule shaderModule;
-		VkShaderModuleCreateInfo moduleCreateInfo{};
-		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		moduleCreateInfo.codeSize = size;
-		moduleCreateInfo.pCode = (uint32_t*)shaderCode;
-		VK_CHECK_RESULT(vkCreateShaderModule(device->handle, &moduleCreateInfo, nullptr, &shaderModule));
-		delete[] shaderCode;
-		return shaderModule;
+		std::lock_guard<std::mutex> lock(shaderModulesMutex);
+		cached = !shaderModuleCacheReleased;
+		auto cachedModule = shaderModules.find(filename);
+		if (cachedModule != shaderModules.end()) {
+			shaderModuleCacheStats.hits++;
+			return cachedModule->second.module;
+		}
 	}
-	else
+
+	std::ifstream is(assetPath + filename, std::ios::binary | std::ios::in | std::ios::ate);
+	if (!is.is_open())
 	{
-		std::cerr << "Error: Could not open shader file \"" << filename << "\"" << std::endl;
+		std::cerr << "Error: Could not open shader file \"" + filename + "\"\n";
 		return VK_NULL_HANDLE;
 	}
-}
-
+	// Read buffer is reused for all shaders loaded on the calling thread
+	// Stored as uint32_t to satisfy SPIR-V alignment requirements
+	thread_local std::vector<uint32_t> shaderCode;
+	size_t size = is.tellg();
+	assert(size > 0);
+	is.seekg(0, std::ios::beg);
+	shaderCode.resize((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+	is.read(reinterpret_cast<char*>(shaderCode.data()), size);
+	is.close();
+	const uint64_t hash = hashShaderCode(reinterpret_cast<const char*>(shaderCode.data()), size);
 
+	std::lock_guard<std::mutex> lock(shaderModulesMutex);
+	shaderModuleCacheStats.bytesRead += size;
+	// Same content may already have been loaded from a different path (or by another thread)
+	auto cachedModule = shaderModulesByHash.find(hash);
+	if (cachedModule != shaderModulesByHash.end()) {
+		shaderModuleCacheStats.hits++;
+		shaderModules[filename] = { hash, cachedModule->second };
+		return cachedModule->second;
+	}
+	shaderModuleCacheStats.misses++;
+	VkShaderModule shaderModule;
+	VkShaderModuleCreateInfo moduleCreateInfo{};
+	moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleCreateInfo.codeSize = size;
+	moduleCreateInfo.pCode = shaderCode.data();
+	VK_CHECK_RESULT(vkCreateShaderModule(device->handle, &moduleCreateInfo, nullptr, &shaderModule));
+	if (shaderModuleCacheReleased) {
+		return shaderModule;
+	}
+	shaderModules[filename] = { hash, shaderModule };
+	shaderModulesByHash[hash] = shaderModule;
+	return shaderModule;
+}
 
+// Shader modules are no longer required once the pipelines using them have been created
+// Call once after all pipelines (including the UI ones) exist
+void AssetManager::releaseShaderModules()
+{
+	std::lock_guard<std::mutex> lock(shaderModulesMutex);
+	shaderModuleCacheReleased = true;
+	for (auto& shaderModule : shaderModulesByHash) {
+		vkDestroyShaderModule(device->handle, shaderModule.second, nullptr);
+	}
+	shaderModules.clear();
+	shaderModulesByHash.clear();
+}
@@ -7,15 +7,25 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 #include <filesystem>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <chrono>
 #include <sys/stat.h>
 
 #include "Device.h"
 #include "Texture.h"
 #include "VulkanTools.h"
 #include "VulkanglTFModel.h"
+#include "JobQueue.h"
+#include "MappedFile.h"
+#include "MeshBuffer.h"
+#include "MaterialBuffer.h"
+#include "JointBuffer.h"
 
 class AssetManager
 {
@@ -24,16 +34,66 @@ private:
 	VkQueue transferQueue;
 	std::map<std::string, vkglTF::Model*> models;
 	std::unordered_map<std::string, Texture*> textures;
+	// Shader modules are cached by path and by content hash, so identical SPIR-V is only turned into a module once
+	struct CachedShaderModule {
+		uint64_t hash;
+		VkShaderModule module;
+	};
+	std::unordered_map<std::string, CachedShaderModule> shaderModules;
+	std::unordered_map<uint64_t, VkShaderModule> shaderModulesByHash;
+	std::mutex shaderModulesMutex;
+	// Set once all pipelines have been created, shaders loaded after that aren't cached and are owned by their pipeline
+	bool shaderModuleCacheReleased = false;
+	// Asynchronous loading
+	// Files are read and decoded on the loader threads, Vulkan resources are created and uploaded on a single upload thread
+	JobQueue* loaderQueue = nullptr;
+	JobQueue* uploadQueue = nullptr;
+	std::atomic<uint32_t> assetsQueued{ 0 };
+	std::atomic<uint32_t> assetsFinished{ 0 };
+	std::mutex assetsMutex;
+	void startAsyncLoading();
 public:
+	struct ShaderModuleCacheStats {
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		size_t bytesRead = 0;
+	} shaderModuleCacheStats;
+	// Model load times, split by source (baked model files or glTF files)
+	struct ModelLoadStats {
+		uint32_t bakedCount = 0;
+		uint32_t glTFCount = 0;
+		double bakedTime = 0.0;
+		double glTFTime = 0.0;
+		uint32_t vertexCount = 0;
+		size_t vertexBytes = 0;
+		uint32_t indexCount = 0;
+		size_t indexBytes = 0;
+	} modelLoadStats;
+	// Static geometry of all models is suballocated from this buffer, bind it once before drawing models
+	MeshBuffer* meshBuffer = nullptr;
+	// Precomputed parameters of all model materials, bound with the camera
+	MaterialBuffer* materialBuffer = nullptr;
+	// Joint matrices of all skins, bound with the camera
+	JointBuffer* jointBuffer = nullptr;
+	// Ignore baked model files, addModelsFolder rebakes all models from their glTF source
+	bool forceModelBake = false;
 	std::string assetPath;
 	void addModelsFolder(std::string folder);
-	vkglTF::Model* getModel(std::string name);
+	vkglTF::Model* getModel(const std::string& name);
 	void addTexturesFolder(std::string folder);
 	Texture* getTexture(std::string name);
+	std::shared_future<vkglTF::Model*> loadModelAsync(std::string name, std::string filename);
+	std::shared_future<Texture*> loadTextureAsync(std::string name, std::string filename);
+	void addModelsFolderAsync(std::string folder);
+	void addTexturesFolderAsync(std::string folder);
+	bool isLoading();
+	float getLoadingProgress();
 	AssetManager();
+	~AssetManager();
 	void setDevice(Device* device);
 	void setTransferQueue(VkQueue queue);
-	VkShaderModule loadShaderShaderModule(std::string filename);
+	VkShaderModule loadShaderShaderModule(std::string filename, bool& cached);
+	void releaseShaderModules();
 };
 
 extern AssetManager* assetManager;
@@ -0,0 +1,521 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	uint16_t packRGB565(const float color[3])
+	{
+		const uint32_t r = (uint32_t)std::min(std::max(color[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+		const uint32_t g = (uint32_t)std::min(std::max(color[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f);
+		const uint32_t b = (uint32_t)std::min(std::max(color[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRGB565(uint16_t packed, int32_t color[3])
+	{
+		const int32_t r = (packed >> 11) & 31;
+		const int32_t g = (packed >> 5) & 63;
+		const int32_t b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// ETC1 intensity modifiers, also used by the individual and differential modes of ETC2
+	const int32_t ETC1_MODIFIERS[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+
+	// EAC alpha modifiers, scaled by the block's multiplier
+	const int32_t EAC_MODIFIERS[16][8] = {
+		{ -3, -6, -9, -15, 2, 5, 8, 14 },
+		{ -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 },
+		{ -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 },
+		{ -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 },
+		{ -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },
+		{ -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },
+		{ -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },
+		{ -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },
+		{ -3, -5, -7, -9, 2, 4, 6, 8 },
+	};
+
+	// Interpolation weights of BC7 4 bit indices and ASTC 2 bit weights, in 1/64
+	const int32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	const int32_t ASTC_WEIGHTS[4] = { 0, 21, 43, 64 };
+
+	// Writes bit fields LSB first into a zero initialized block
+	struct BitWriter {
+		unsigned char* target;
+		uint32_t position = 0;
+		void write(uint32_t value, uint32_t count) {
+			for (uint32_t i = 0; i < count; i++, position++) {
+				if ((value >> i) & 1) {
+					target[position >> 3] |= 1 << (position & 7);
+				}
+			}
+		}
+	};
+
+	int32_t clampByte(int32_t value)
+	{
+		return std::min(std::max(value, 0), 255);
+	}
+
+	// Returns the index of the palette entry closest to every texel of the block, compares the given number of channels
+	template<uint32_t paletteSize>
+	int32_t findClosest(const unsigned char* block, const int32_t palette[paletteSize][4], uint32_t channels, uint32_t indices[16])
+	{
+		int32_t error = 0;
+		for (uint32_t i = 0; i < 16; i++) {
+			int32_t bestDistance = INT32_MAX;
+			for (uint32_t p = 0; p < paletteSize; p++) {
+				int32_t distance = 0;
+				for (uint32_t c = 0; c < channels; c++) {
+					const int32_t d = block[i * 4 + c] - palette[p][c];
+					distance += d * d;
+				}
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					indices[i] = p;
+				}
+			}
+			error += bestDistance;
+		}
+		return error;
+	}
+}
+
+size_t BlockCompressor::getBlockSize(Format format)
+{
+	return ((format == BC1) || (format == ETC2_RGB)) ? 8 : 16;
+}
+
+bool BlockCompressor::hasAlpha(const unsigned char* rgba, size_t pixelCount)
+{
+	for (size_t i = 0; i < pixelCount; i++) {
+		if (rgba[i * 4 + 3] < 255) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void BlockCompressor::compress(const unsigned char* rgba, uint32_t width, uint32_t height, Format format, std::vector<unsigned char>& target)
+{
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+	target.resize((size_t)blocksX * blocksY * blockSize);
+	unsigned char block[64];
+	unsigned char* output = target.data();
+	for (uint32_t by = 0; by < blocksY; by++) {
+		for (uint32_t bx = 0; bx < blocksX; bx++) {
+			for (uint32_t y = 0; y < 4; y++) {
+				for (uint32_t x = 0; x < 4; x++) {
+					const uint32_t sx = std::min(bx * 4 + x, width - 1);
+					const uint32_t sy = std::min(by * 4 + y, height - 1);
+					memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+				}
+			}
+			switch (format) {
+			case BC1:
+				compressBC1Block(block, output);
+				break;
+			case BC7:
+				compressBC7Block(block, output);
+				break;
+			case ETC2_RGB:
+				compressETC1Block(block, output);
+				break;
+			case ETC2_RGBA:
+				compressEACBlock(block, output);
+				compressETC1Block(block, output + 8);
+				break;
+			case ASTC_4x4:
+				compressASTCBlock(block, output);
+				break;
+			}
+			output += blockSize;
+		}
+	}
+}
+
+// Fits both endpoints along the principal axis of the first channels of the block's texels
+// Unused channels of the endpoints are set to opaque white
+void BlockCompressor::fitEndpoints(const unsigned char* block, uint32_t channels, float endpoint0[4], float endpoint1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < channels; c++) {
+			mean[c] += block[i * 4 + c];
+		}
+	}
+	for (uint32_t c = 0; c < channels; c++) {
+		mean[c] /= 16.0f;
+	}
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t a = 0; a < channels; a++) {
+			for (uint32_t b = 0; b < channels; b++) {
+				covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+			}
+		}
+	}
+	// Principal axis via power iteration
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (uint32_t iteration = 0; iteration < 4; iteration++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (uint32_t a = 0; a < channels; a++) {
+			for (uint32_t b = 0; b < channels; b++) {
+				next[a] += axis[b] * covariance[a][b];
+			}
+			length = std::max(length, fabsf(next[a]));
+		}
+		if (length < 1e-6f) {
+			break;
+		}
+		for (uint32_t c = 0; c < channels; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+	float axisLengthSquared = 0.0f;
+	for (uint32_t c = 0; c < channels; c++) {
+		axisLengthSquared += axis[c] * axis[c];
+	}
+	for (uint32_t i = 0; i < 16; i++) {
+		float projection = 0.0f;
+		for (uint32_t c = 0; c < channels; c++) {
+			projection += (block[i * 4 + c] - mean[c]) * axis[c];
+		}
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+	if (axisLengthSquared > 0.0f) {
+		minProjection /= axisLengthSquared;
+		maxProjection /= axisLengthSquared;
+	}
+	// Inset the endpoints a bit, as the extremes are rarely hit exactly and the interpolated colors cover more texels that way
+	const float inset = (maxProjection - minProjection) / 16.0f;
+	minProjection += inset;
+	maxProjection -= inset;
+	for (uint32_t c = 0; c < 4; c++) {
+		endpoint0[c] = (c < channels) ? std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f) : 255.0f;
+		endpoint1[c] = (c < channels) ? std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f) : 255.0f;
+	}
+}
+
+// Selects the closest of the four palette entries between the fitted endpoints for every texel
+void BlockCompressor::compressBC1Block(const unsigned char* block, unsigned char* target)
+{
+	float endpoint0[4], endpoint1[4];
+	fitEndpoints(block, 3, endpoint0, endpoint1);
+	uint16_t color0 = packRGB565(endpoint0);
+	uint16_t color1 = packRGB565(endpoint1);
+	// Four color mode requires color0 > color1
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int32_t palette[4][4];
+		unpackRGB565(color0, palette[0]);
+		unpackRGB565(color1, palette[1]);
+		for (uint32_t c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		uint32_t texelIndices[16];
+		findClosest<4>(block, palette, 3, texelIndices);
+		for (uint32_t i = 0; i < 16; i++) {
+			indices |= texelIndices[i] << (i * 2);
+		}
+	}
+	target[0] = color0 & 0xFF;
+	target[1] = color0 >> 8;
+	target[2] = color1 & 0xFF;
+	target[3] = color1 >> 8;
+	for (uint32_t i = 0; i < 4; i++) {
+		target[4 + i] = (indices >> (i * 8)) & 0xFF;
+	}
+}
+
+// Mode 6: a single subset with 7 bit RGBA endpoints, a p-bit per endpoint and 4 bit indices
+void BlockCompressor::compressBC7Block(const unsigned char* block, unsigned char* target)
+{
+	float endpoints[2][4];
+	fitEndpoints(block, 4, endpoints[0], endpoints[1]);
+	// The p-bit is the shared lowest bit of all channels of an endpoint, pick the one with the lower error
+	uint32_t quantized[2][4];
+	uint32_t pBits[2];
+	for (uint32_t e = 0; e < 2; e++) {
+		float bestError = FLT_MAX;
+		for (uint32_t p = 0; p < 2; p++) {
+			uint32_t values[4];
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				values[c] = (uint32_t)std::min(std::max((endpoints[e][c] - (float)p) / 2.0f + 0.5f, 0.0f), 127.0f);
+				const float d = (float)((values[c] << 1) | p) - endpoints[e][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				pBits[e] = p;
+				memcpy(quantized[e], values, sizeof(values));
+			}
+		}
+	}
+	int32_t palette[16][4];
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			const int32_t e0 = (quantized[0][c] << 1) | pBits[0];
+			const int32_t e1 = (quantized[1][c] << 1) | pBits[1];
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6;
+		}
+	}
+	uint32_t indices[16];
+	findClosest<16>(block, palette, 4, indices);
+	// The most significant index bit of the first texel is implicitly zero, swap the endpoints if it's set
+	if (indices[0] & 8) {
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (uint32_t i = 0; i < 16; i++) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+	memset(target, 0, 16);
+	BitWriter writer{ target };
+	writer.write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.write(quantized[0][c], 7);
+		writer.write(quantized[1][c], 7);
+	}
+	writer.write(pBits[0], 1);
+	writer.write(pBits[1], 1);
+	for (uint32_t i = 0; i < 16; i++) {
+		writer.write(indices[i], (i == 0) ? 3 : 4);
+	}
+}
+
+// Individual and differential modes only, which makes the blocks valid for ETC1 and ETC2 decoders
+// Tries both subblock orientations and modes and keeps the encoding with the lowest error
+void BlockCompressor::compressETC1Block(const unsigned char* block, unsigned char* target)
+{
+	int32_t bestError = INT32_MAX;
+	for (uint32_t flip = 0; flip < 2; flip++) {
+		// Texels of both subblocks, the 2x4 halves if not flipped and the 4x2 halves if flipped
+		uint32_t texels[2][8];
+		float average[2][3] = {};
+		for (uint32_t s = 0; s < 2; s++) {
+			for (uint32_t i = 0; i < 8; i++) {
+				const uint32_t x = flip ? (i % 4) : (s * 2 + i / 4);
+				const uint32_t y = flip ? (s * 2 + i / 4) : (i % 4);
+				texels[s][i] = y * 4 + x;
+				for (uint32_t c = 0; c < 3; c++) {
+					average[s][c] += block[texels[s][i] * 4 + c] / 8.0f;
+				}
+			}
+		}
+		for (uint32_t differential = 0; differential < 2; differential++) {
+			int32_t codes[2][3];
+			int32_t baseColors[2][3];
+			bool valid = true;
+			for (uint32_t s = 0; s < 2; s++) {
+				for (uint32_t c = 0; c < 3; c++) {
+					if (differential) {
+						codes[s][c] = (int32_t)(average[s][c] * 31.0f / 255.0f + 0.5f);
+						baseColors[s][c] = (codes[s][c] << 3) | (codes[s][c] >> 2);
+					}
+					else {
+						codes[s][c] = (int32_t)(average[s][c] * 15.0f / 255.0f + 0.5f);
+						baseColors[s][c] = (codes[s][c] << 4) | codes[s][c];
+					}
+				}
+			}
+			if (differential) {
+				for (uint32_t c = 0; c < 3; c++) {
+					const int32_t delta = codes[1][c] - codes[0][c];
+					valid &= (delta >= -4) && (delta <= 3);
+				}
+			}
+			if (!valid) {
+				continue;
+			}
+			// Pick the modifier table with the lowest error per subblock
+			int32_t error = 0;
+			uint32_t tables[2];
+			uint32_t selectors[16];
+			for (uint32_t s = 0; s < 2; s++) {
+				int32_t bestSubblockError = INT32_MAX;
+				for (uint32_t t = 0; t < 8; t++) {
+					int32_t palette[4][4];
+					const int32_t modifiers[4] = { ETC1_MODIFIERS[t][0], ETC1_MODIFIERS[t][1], -ETC1_MODIFIERS[t][0], -ETC1_MODIFIERS[t][1] };
+					for (uint32_t m = 0; m < 4; m++) {
+						for (uint32_t c = 0; c < 3; c++) {
+							palette[m][c] = clampByte(baseColors[s][c] + modifiers[m]);
+						}
+					}
+					int32_t subblockError = 0;
+					uint32_t subblockSelectors[8];
+					for (uint32_t i = 0; i < 8; i++) {
+						int32_t bestDistance = INT32_MAX;
+						for (uint32_t m = 0; m < 4; m++) {
+							int32_t distance = 0;
+							for (uint32_t c = 0; c < 3; c++) {
+								const int32_t d = block[texels[s][i] * 4 + c] - palette[m][c];
+								distance += d * d;
+							}
+							if (distance < bestDistance) {
+								bestDistance = distance;
+								subblockSelectors[i] = m;
+							}
+						}
+						subblockError += bestDistance;
+					}
+					if (subblockError < bestSubblockError) {
+						bestSubblockError = subblockError;
+						tables[s] = t;
+						for (uint32_t i = 0; i < 8; i++) {
+							selectors[texels[s][i]] = subblockSelectors[i];
+						}
+					}
+				}
+				error += bestSubblockError;
+			}
+			if (error >= bestError) {
+				continue;
+			}
+			bestError = error;
+			// Blocks are stored big endian, texel selectors are split into a plane of most and one of least significant bits in column major order
+			for (uint32_t c = 0; c < 3; c++) {
+				target[c] = differential ? (unsigned char)((codes[0][c] << 3) | ((codes[1][c] - codes[0][c]) & 7)) : (unsigned char)((codes[0][c] << 4) | codes[1][c]);
+			}
+			target[3] = (unsigned char)((tables[0] << 5) | (tables[1] << 2) | (differential << 1) | flip);
+			uint32_t msb = 0;
+			uint32_t lsb = 0;
+			for (uint32_t y = 0; y < 4; y++) {
+				for (uint32_t x = 0; x < 4; x++) {
+					const uint32_t selector = selectors[y * 4 + x];
+					msb |= (selector >> 1) << (x * 4 + y);
+					lsb |= (selector & 1) << (x * 4 + y);
+				}
+			}
+			target[4] = (msb >> 8) & 0xFF;
+			target[5] = msb & 0xFF;
+			target[6] = (lsb >> 8) & 0xFF;
+			target[7] = lsb & 0xFF;
+		}
+	}
+}
+
+// Derives the base value and multiplier of every modifier table from the block's alpha range and keeps the table with the lowest error
+void BlockCompressor::compressEACBlock(const unsigned char* block, unsigned char* target)
+{
+	int32_t minAlpha = 255;
+	int32_t maxAlpha = 0;
+	for (uint32_t i = 0; i < 16; i++) {
+		minAlpha = std::min(minAlpha, (int32_t)block[i * 4 + 3]);
+		maxAlpha = std::max(maxAlpha, (int32_t)block[i * 4 + 3]);
+	}
+	int32_t bestError = INT32_MAX;
+	uint64_t bestBits = 0;
+	for (uint32_t t = 0; t < 16; t++) {
+		int32_t minModifier = 0;
+		int32_t maxModifier = 0;
+		for (uint32_t m = 0; m < 8; m++) {
+			minModifier = std::min(minModifier, EAC_MODIFIERS[t][m]);
+			maxModifier = std::max(maxModifier, EAC_MODIFIERS[t][m]);
+		}
+		const int32_t multiplier = std::min(std::max((int32_t)((float)(maxAlpha - minAlpha) / (float)(maxModifier - minModifier) + 0.5f), 1), 15);
+		const int32_t base = clampByte((int32_t)((float)(maxAlpha + minAlpha) / 2.0f - (float)(multiplier * (maxModifier + minModifier)) / 2.0f + 0.5f));
+		int32_t error = 0;
+		uint64_t bits = ((uint64_t)base << 56) | ((uint64_t)multiplier << 52) | ((uint64_t)t << 48);
+		for (uint32_t x = 0; x < 4; x++) {
+			for (uint32_t y = 0; y < 4; y++) {
+				const int32_t alpha = block[(y * 4 + x) * 4 + 3];
+				int32_t bestDistance = INT32_MAX;
+				uint64_t bestIndex = 0;
+				for (uint32_t m = 0; m < 8; m++) {
+					const int32_t distance = abs(alpha - clampByte(base + EAC_MODIFIERS[t][m] * multiplier));
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = m;
+					}
+				}
+				error += bestDistance * bestDistance;
+				// Column major, the first texel is stored in the most significant bits
+				bits |= bestIndex << (45 - (x * 4 + y) * 3);
+			}
+		}
+		if (error < bestError) {
+			bestError = error;
+			bestBits = bits;
+		}
+	}
+	for (uint32_t i = 0; i < 8; i++) {
+		target[i] = (bestBits >> (56 - i * 8)) & 0xFF;
+	}
+}
+
+// Single partition 4x4 block with 2 bit weights and 8 bit RGBA endpoints (LDR RGBA direct, color endpoint mode 12)
+void BlockCompressor::compressASTCBlock(const unsigned char* block, unsigned char* target)
+{
+	float endpoints[2][4];
+	fitEndpoints(block, 4, endpoints[0], endpoints[1]);
+	int32_t colors[2][4];
+	for (uint32_t e = 0; e < 2; e++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			colors[e][c] = clampByte((int32_t)(endpoints[e][c] + 0.5f));
+		}
+	}
+	// Endpoints are decoded swapped and blue contracted if the second endpoint's RGB sum is lower than the first one's
+	if (colors[1][0] + colors[1][1] + colors[1][2] < colors[0][0] + colors[0][1] + colors[0][2]) {
+		std::swap(colors[0], colors[1]);
+	}
+	int32_t palette[4][4];
+	for (uint32_t i = 0; i < 4; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			palette[i][c] = ((64 - ASTC_WEIGHTS[i]) * colors[0][c] + ASTC_WEIGHTS[i] * colors[1][c] + 32) >> 6;
+		}
+	}
+	uint32_t weights[16];
+	findClosest<4>(block, palette, 4, weights);
+	memset(target, 0, 16);
+	BitWriter writer{ target };
+	// Block mode for a 4x4 weight grid with 2 bit weights, a single partition and color endpoint mode 12
+	writer.write(0x42, 11);
+	writer.write(0, 2);
+	writer.write(12, 4);
+	// With the remaining bits all endpoint values are stored at 8 bits
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.write(colors[0][c], 8);
+		writer.write(colors[1][c], 8);
+	}
+	// Weights are stored in reverse bit order starting at the end of the block
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t b = 0; b < 2; b++) {
+			if ((weights[i] >> b) & 1) {
+				const uint32_t position = 127 - (i * 2 + b);
+				target[position >> 3] |= 1 << (position & 7);
+			}
+		}
+	}
+}
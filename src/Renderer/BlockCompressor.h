@@ -0,0 +1,31 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// CPU encoders for the block compressed formats of desktop (BC1, BC7) and mobile GPUs (ETC2, ASTC)
+// Endpoints are fitted along the principal axis of each 4x4 block's colors, quality is comparable to real-time encoders
+// BC7 only uses mode 6 and ASTC only uses a single partition with 2 bit weights, both store RGBA
+class BlockCompressor
+{
+public:
+	enum Format { BC1, BC7, ETC2_RGB, ETC2_RGBA, ASTC_4x4 };
+	static size_t getBlockSize(Format format);
+	static bool hasAlpha(const unsigned char* rgba, size_t pixelCount);
+	// Compresses a tightly packed RGBA8 image, partial blocks at the borders are padded by repeating edge texels
+	static void compress(const unsigned char* rgba, uint32_t width, uint32_t height, Format format, std::vector<unsigned char>& target);
+private:
+	static void fitEndpoints(const unsigned char* block, uint32_t channels, float endpoint0[4], float endpoint1[4]);
+	static void compressBC1Block(const unsigned char* block, unsigned char* target);
+	static void compressBC7Block(const unsigned char* block, unsigned char* target);
+	static void compressETC1Block(const unsigned char* block, unsigned char* target);
+	static void compressEACBlock(const unsigned char* block, unsigned char* target);
+	static void compressASTCBlock(const unsigned char* block, unsigned char* target);
+};
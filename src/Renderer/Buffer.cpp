@@ -66,6 +66,10 @@ VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 
 void Buffer::destroy()
 {
+	if (memoryTracker) {
+		memoryTracker->free(memoryCategory, allocationSize);
+		memoryTracker = nullptr;
+	}
 	if (vmaAllocator) {
 		vmaDestroyBuffer((VmaAllocator)*vmaAllocator, buffer, vmaAllocation);
 	}
@@ -12,6 +12,7 @@
 #include "VulkanTools.h"
 #include "vk_mem_alloc.h"
 #include "DescriptorSet.h"
+#include "MemoryTracker.h"
 
 class Buffer
 {
@@ -28,6 +29,10 @@ public:
 	VkBufferUsageFlags usageFlags;
 	VkMemoryPropertyFlags memoryPropertyFlags;
 	VmaAllocation vmaAllocation;
+	// Set by Device::createBuffer, the allocation is reported to the tracker when the buffer is destroyed
+	MemoryTracker* memoryTracker = nullptr;
+	MemoryCategory memoryCategory = MemoryCategory::Other;
+	VkDeviceSize allocationSize = 0;
 	VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 	void unmap();
 	VkResult bind(VkDeviceSize offset = 0);
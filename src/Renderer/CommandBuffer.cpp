@@ -57,12 +57,23 @@ void CommandBuffer::setScissor(int32_t offsetx, int32_t offsety, uint32_t width,
 	vkCmdSetScissor(handle, 0, 1, &scissor);
 }
 
-void CommandBuffer::bindDescriptorSets(PipelineLayout* layout, std::vector<DescriptorSet*> sets, uint32_t firstSet) {
-	std::vector<VkDescriptorSet> descSets;
-	for (auto set : sets) {
-		descSets.push_back(set->handle);
+// Handles are gathered on the stack, as this is called several times per frame
+void CommandBuffer::bindDescriptorSets(PipelineLayout* layout, DescriptorSet* const* sets, uint32_t setCount, uint32_t firstSet, const uint32_t* dynamicOffsets, uint32_t dynamicOffsetCount) {
+	const uint32_t maxSetCount = 8;
+	assert(setCount <= maxSetCount);
+	VkDescriptorSet descSets[maxSetCount];
+	for (uint32_t i = 0; i < setCount; i++) {
+		descSets[i] = sets[i]->handle;
 	}
-	vkCmdBindDescriptorSets(handle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->handle, firstSet, static_cast<uint32_t>(descSets.size()), descSets.data(), 0, nullptr);
+	vkCmdBindDescriptorSets(handle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->handle, firstSet, setCount, descSets, dynamicOffsetCount, dynamicOffsets);
+}
+
+void CommandBuffer::bindDescriptorSets(PipelineLayout* layout, std::initializer_list<DescriptorSet*> sets, uint32_t firstSet, std::initializer_list<uint32_t> dynamicOffsets) {
+	bindDescriptorSets(layout, sets.begin(), static_cast<uint32_t>(sets.size()), firstSet, dynamicOffsets.begin(), static_cast<uint32_t>(dynamicOffsets.size()));
+}
+
+void CommandBuffer::bindDescriptorSets(PipelineLayout* layout, const std::vector<DescriptorSet*>& sets, uint32_t firstSet, std::initializer_list<uint32_t> dynamicOffsets) {
+	bindDescriptorSets(layout, sets.data(), static_cast<uint32_t>(sets.size()), firstSet, dynamicOffsets.begin(), static_cast<uint32_t>(dynamicOffsets.size()));
 }
 
 void CommandBuffer::bindPipeline(Pipeline* pipeline) {
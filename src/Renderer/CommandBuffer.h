@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <vector>
+#include <initializer_list>
 #include "vulkan/vulkan.h"
 #include "VulkanInitializers.h"
 #include "VulkanTools.h"
@@ -22,6 +24,7 @@ private:
 	VkDevice device;
 	CommandPool *pool = nullptr;
 	VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	void bindDescriptorSets(PipelineLayout* layout, DescriptorSet* const* sets, uint32_t setCount, uint32_t firstSet, const uint32_t* dynamicOffsets, uint32_t dynamicOffsetCount);
 public:
 	VkCommandBuffer handle;
 	CommandBuffer(VkDevice device);
@@ -35,7 +38,8 @@ public:
 	void endRenderPass();
 	void setViewport(float x, float y, float width, float height, float minDepth, float maxDepth);
 	void setScissor(int32_t offsetx, int32_t offsety, uint32_t width, uint32_t height);
-	void bindDescriptorSets(PipelineLayout* layout, std::vector<DescriptorSet*> sets, uint32_t firstSet = 0);
+	void bindDescriptorSets(PipelineLayout* layout, std::initializer_list<DescriptorSet*> sets, uint32_t firstSet = 0, std::initializer_list<uint32_t> dynamicOffsets = {});
+	void bindDescriptorSets(PipelineLayout* layout, const std::vector<DescriptorSet*>& sets, uint32_t firstSet = 0, std::initializer_list<uint32_t> dynamicOffsets = {});
 	void bindPipeline(Pipeline* pipeline);
 	void bindVertexBuffer(Buffer& buffer, uint32_t binding, VkDeviceSize offset = 0);
 	void bindIndexBuffer(Buffer& buffer, VkIndexType indexType, VkDeviceSize offset = 0);
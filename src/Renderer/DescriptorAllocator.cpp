@@ -0,0 +1,102 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "DescriptorAllocator.h"
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device)
+{
+	this->device = device;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	for (VkDescriptorPool pool : pools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+}
+
+// Sizes of every pool in the chain, new pools are only added if a pool runs out of space
+void DescriptorAllocator::setMaxSets(uint32_t maxSets)
+{
+	this->maxSets = maxSets;
+}
+
+void DescriptorAllocator::addPoolSize(VkDescriptorType type, uint32_t descriptorCount)
+{
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = type;
+	poolSize.descriptorCount = descriptorCount;
+	poolSizes.push_back(poolSize);
+}
+
+VkDescriptorPool DescriptorAllocator::createPool()
+{
+	assert(poolSizes.size() > 0);
+	VkDescriptorPoolCreateInfo CI{};
+	CI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	CI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	CI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	CI.pPoolSizes = poolSizes.data();
+	CI.maxSets = maxSets;
+	VkDescriptorPool pool;
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &CI, nullptr, &pool));
+	stats.poolCount++;
+	return pool;
+}
+
+VkResult DescriptorAllocator::allocateFromPool(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet& descriptorSet)
+{
+	VkDescriptorSetAllocateInfo descriptorSetAI = vks::initializers::descriptorSetAllocateInfo(pool, &layout, 1);
+	return vkAllocateDescriptorSets(device, &descriptorSetAI, &descriptorSet);
+}
+
+// Allocates a set from the first pool of the chain with enough space left, a new pool is chained if all are full
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+	// Sets may have been freed from any pool, so older pools are tried too
+	for (auto pool = pools.rbegin(); pool != pools.rend(); pool++) {
+		result = allocateFromPool(*pool, layout, descriptorSet);
+		if (result == VK_SUCCESS) {
+			setPools[descriptorSet] = *pool;
+			break;
+		}
+	}
+	if ((result == VK_ERROR_OUT_OF_POOL_MEMORY) || (result == VK_ERROR_FRAGMENTED_POOL)) {
+		pools.push_back(createPool());
+		VK_CHECK_RESULT(allocateFromPool(pools.back(), layout, descriptorSet));
+		setPools[descriptorSet] = pools.back();
+		result = VK_SUCCESS;
+	}
+	VK_CHECK_RESULT(result);
+	stats.allocatedSets++;
+	stats.allocationsThisFrame++;
+	return descriptorSet;
+}
+
+// Returns a set to its pool
+void DescriptorAllocator::free(VkDescriptorSet descriptorSet)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pool = setPools.find(descriptorSet);
+	if (pool == setPools.end()) {
+		std::cerr << "Freed descriptor set has not been allocated from this allocator\n";
+		return;
+	}
+	VK_CHECK_RESULT(vkFreeDescriptorSets(device, pool->second, 1, &descriptorSet));
+	setPools.erase(pool);
+	stats.allocatedSets--;
+}
+
+// Only updates the per-frame statistics, sets are never reset as a whole
+void DescriptorAllocator::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.allocationsLastFrame = stats.allocationsThisFrame;
+	stats.allocationsThisFrame = 0;
+}
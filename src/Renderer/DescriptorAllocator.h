@@ -0,0 +1,45 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+// Allocates descriptor sets from a chain of pools that grows on demand
+// Pools allow freeing single sets, sets are returned with free once their owner goes away
+class DescriptorAllocator
+{
+public:
+	struct Stats {
+		// Sets currently allocated
+		uint32_t allocatedSets = 0;
+		// Sets allocated in the last completed frame
+		uint32_t allocationsLastFrame = 0;
+		uint32_t allocationsThisFrame = 0;
+		uint32_t poolCount = 0;
+	} stats;
+	DescriptorAllocator(VkDevice device);
+	~DescriptorAllocator();
+	void setMaxSets(uint32_t maxSets);
+	void addPoolSize(VkDescriptorType type, uint32_t descriptorCount);
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	void free(VkDescriptorSet descriptorSet);
+	void beginFrame();
+private:
+	VkDevice device;
+	std::mutex mutex;
+	uint32_t maxSets = 256;
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	std::vector<VkDescriptorPool> pools;
+	std::unordered_map<VkDescriptorSet, VkDescriptorPool> setPools;
+	VkDescriptorPool createPool();
+	VkResult allocateFromPool(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet& descriptorSet);
+};
@@ -13,13 +13,22 @@ DescriptorSet::DescriptorSet(VkDevice device)
 
 DescriptorSet::~DescriptorSet() 
 {
-	// @todo
+	// Sets from a plain pool are released when their pool is destroyed
+	if (allocator && handle) {
+		allocator->free(handle);
+	}
 }
 
 void DescriptorSet::create() 
 {
-	VkDescriptorSetAllocateInfo descriptorSetAI = vks::initializers::descriptorSetAllocateInfo(pool->handle, layouts.data(), static_cast<uint32_t>(layouts.size()));
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAI, &handle));
+	if (allocator) {
+		assert(layouts.size() == 1);
+		handle = allocator->allocate(layouts[0]);
+	}
+	else {
+		VkDescriptorSetAllocateInfo descriptorSetAI = vks::initializers::descriptorSetAllocateInfo(pool->handle, layouts.data(), static_cast<uint32_t>(layouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAI, &handle));
+	}
 	for (auto& descriptor : descriptors) {
 		descriptor.dstSet = handle;
 	}
@@ -31,6 +40,12 @@ void DescriptorSet::setPool(DescriptorPool* pool)
 	this->pool = pool;
 }
 
+// Sets from an allocator are returned to the allocator when this object is deleted
+void DescriptorSet::setAllocator(DescriptorAllocator* allocator) 
+{
+	this->allocator = allocator;
+}
+
 void DescriptorSet::addLayout(VkDescriptorSetLayout layout) 
 {
 	layouts.push_back(layout);
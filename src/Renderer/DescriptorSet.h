@@ -12,19 +12,22 @@
 #include "VulkanTools.h"
 #include "DescriptorSetLayout.h"
 #include "DescriptorPool.h"
+#include "DescriptorAllocator.h"
 
 class DescriptorSet {
 private:
 	VkDevice device = VK_NULL_HANDLE;
 	DescriptorPool *pool = nullptr;
+	DescriptorAllocator* allocator = nullptr;
 	std::vector<VkDescriptorSetLayout> layouts;
 	std::vector<VkWriteDescriptorSet> descriptors;
 public:
-	VkDescriptorSet handle;
+	VkDescriptorSet handle = VK_NULL_HANDLE;
 	DescriptorSet(VkDevice device);
 	~DescriptorSet();
 	void create();
 	void setPool(DescriptorPool* pool);
+	void setAllocator(DescriptorAllocator* allocator);
 	void addLayout(VkDescriptorSetLayout layout);
 	void addLayout(DescriptorSetLayout* layout);
 	void addDescriptor(VkWriteDescriptorSet descriptor);
@@ -44,7 +44,12 @@ Device::~Device()
 {
 	if (handle)
 	{
+		for (auto& threadCommandPool : threadCommandPools) {
+			vkDestroyCommandPool(handle, threadCommandPool.second, nullptr);
+		}
+		vkDestroyCommandPool(handle, commandPool, nullptr);
 		vkDestroyDevice(handle, nullptr);
+		delete memoryTracker;
 		vmaDestroyAllocator(vmaAllocator);
 	}
 }
@@ -212,15 +217,18 @@ VkResult Device::create(VkQueueFlags requestedQueueTypes)
 		deviceCreateInfo.pNext = &physicalDeviceFeatures2;
 	}
 
+	// Heap usage and budgets are reported by the driver if the memory budget extension is present
+	const bool memoryBudgetSupported = extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported) {
+		deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
 	// Enable the debug marker extension if it is present (likely meaning a debugging tool is present)
 	if (extensionSupported(VK_EXT_DEBUG_MARKER_EXTENSION_NAME))
 	{
 		deviceExtensions.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
 	}
 
-	deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
-	deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
-
 	if (deviceExtensions.size() > 0)
 	{
 		deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
@@ -232,6 +240,7 @@ VkResult Device::create(VkQueueFlags requestedQueueTypes)
 	if (result == VK_SUCCESS)
 	{
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
+		mainThreadId = std::this_thread::get_id();
 	}
 
 	this->enabledFeatures = enabledFeatures;
@@ -241,7 +250,11 @@ VkResult Device::create(VkQueueFlags requestedQueueTypes)
 	allocatorInfo.device = handle;
 	allocatorInfo.physicalDevice = physicalDevice;
 	allocatorInfo.instance = instance->handle;
+	if (memoryBudgetSupported) {
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
 	vmaCreateAllocator(&allocatorInfo, &vmaAllocator);
+	memoryTracker = new MemoryTracker(vmaAllocator, memoryProperties, memoryBudgetSupported);
 
 	return result;
 }
@@ -259,7 +272,7 @@ void Device::setDebugObjectName(VkObjectType type, uint64_t handle, const char*
 	vks::debug::vkSetDebugUtilsObjectNameEXT(this->handle, &nameInfo);
 }
 
-VkResult Device::createBuffer(VkBufferUsageFlags usageFlags, VmaMemoryUsage memoryUsage, Buffer* buffer, VkDeviceSize size, void* data)
+VkResult Device::createBuffer(VkBufferUsageFlags usageFlags, VmaMemoryUsage memoryUsage, Buffer* buffer, VkDeviceSize size, void* data, MemoryCategory category)
 {
 	VkBufferCreateInfo bufferCI{};
 	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -275,6 +288,10 @@ VkResult Device::createBuffer(VkBufferUsageFlags usageFlags, VmaMemoryUsage memo
 
 	buffer->mapped = allocInfo.pMappedData;
 	buffer->vmaAllocator = &vmaAllocator;
+	buffer->memoryTracker = memoryTracker;
+	buffer->memoryCategory = category;
+	buffer->allocationSize = allocInfo.size;
+	memoryTracker->allocate(category, allocInfo.size);
 
 	if (data != nullptr)
 	{
@@ -318,9 +335,22 @@ VkCommandPool Device::createCommandPool(uint32_t queueFamilyIndex, VkCommandPool
 	return cmdPool;
 }
 
+VkCommandPool Device::getCommandPool()
+{
+	const std::thread::id threadId = std::this_thread::get_id();
+	if (threadId == mainThreadId) {
+		return commandPool;
+	}
+	std::lock_guard<std::mutex> lock(commandPoolsMutex);
+	if (threadCommandPools.count(threadId) == 0) {
+		threadCommandPools[threadId] = createCommandPool(queueFamilyIndices.graphics);
+	}
+	return threadCommandPools[threadId];
+}
+
 VkCommandBuffer Device::createCommandBuffer(VkCommandBufferLevel level, bool begin)
 {
-	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, level, 1);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(getCommandPool(), level, 1);
 
 	VkCommandBuffer cmdBuffer;
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(handle, &cmdBufAllocateInfo, &cmdBuffer));
@@ -354,15 +384,19 @@ void Device::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bo
 	VK_CHECK_RESULT(vkCreateFence(handle, &fenceInfo, nullptr, &fence));
 
 	// Submit to the queue
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+	}
 	// Wait for the fence to signal that command buffer has finished executing
 	VK_CHECK_RESULT(vkWaitForFences(handle, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+	blockingSubmitCount++;
 
 	vkDestroyFence(handle, fence, nullptr);
 
 	if (free)
 	{
-		vkFreeCommandBuffers(handle, commandPool, 1, &commandBuffer);
+		vkFreeCommandBuffers(handle, getCommandPool(), 1, &commandBuffer);
 	}
 }
 
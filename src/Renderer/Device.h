@@ -8,15 +8,28 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "vulkan/vulkan.h"
 #include "Buffer.h"
 #include "Instance.h"
 #include "vk_mem_alloc.h"
+#include "MemoryTracker.h"
+
+class UploadManager;
+class SamplerCache;
 
 class Device
 {
 private:
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	// Command pools can't be used from multiple threads, so threads other than the one creating the device get their own pool
+	std::thread::id mainThreadId;
+	std::unordered_map<std::thread::id, VkCommandPool> threadCommandPools;
+	std::mutex commandPoolsMutex;
+	VkCommandPool getCommandPool();
 	Instance* instance = nullptr;
 	void* pNext = nullptr;
 	std::vector<const char*> enabledExtensions;
@@ -30,6 +43,16 @@ public:
 	VkPhysicalDeviceMemoryProperties memoryProperties;
 	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 	std::vector<std::string> supportedExtensions;
+	// Queue submissions need to be externally synchronized, lock this when submitting from multiple threads
+	std::mutex queueMutex;
+	// Batched uploads for resource creation, see UploadManager
+	UploadManager* uploadManager = nullptr;
+	// Shared samplers, acquire samplers from here instead of creating them directly
+	SamplerCache* samplerCache = nullptr;
+	// GPU memory usage per category and heap budgets, created along with the memory allocator
+	MemoryTracker* memoryTracker = nullptr;
+	// Number of blocking submits done via flushCommandBuffer
+	std::atomic<uint32_t> blockingSubmitCount{ 0 };
 	struct
 	{
 		uint32_t graphics;
@@ -40,7 +63,7 @@ public:
 	~Device();
 	uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32* memTypeFound = nullptr);
 	uint32_t getQueueFamilyIndex(VkQueueFlagBits queueFlags);
-	VkResult createBuffer(VkBufferUsageFlags usageFlags, VmaMemoryUsage memoryUsage, Buffer* buffer, VkDeviceSize size, void* data = nullptr);
+	VkResult createBuffer(VkBufferUsageFlags usageFlags, VmaMemoryUsage memoryUsage, Buffer* buffer, VkDeviceSize size, void* data = nullptr, MemoryCategory category = MemoryCategory::Other);
 	void copyBuffer(Buffer* src, Buffer* dst, VkQueue queue, VkBufferCopy* copyRegion = nullptr);
 	VkCommandPool createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
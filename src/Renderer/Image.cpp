@@ -11,6 +11,9 @@ Image::Image(Device* device) {
 }
 
 Image::~Image() {
+	if (memorySize > 0) {
+		device->memoryTracker->free(memoryCategory, memorySize);
+	}
 	vkFreeMemory(device->handle, memory, nullptr);
 	vkDestroyImage(device->handle, handle, nullptr);
 }
@@ -33,6 +36,8 @@ void Image::create() {
 	memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAlloc, nullptr, &memory));
 	VK_CHECK_RESULT(vkBindImageMemory(device->handle, handle, memory, 0));
+	memorySize = memReqs.size;
+	device->memoryTracker->allocate(memoryCategory, memorySize);
 }
 
 void Image::setType(VkImageType type) {
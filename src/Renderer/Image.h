@@ -25,6 +25,8 @@ private:
 	VkImageTiling tiling;
 	VkImageUsageFlags usage;
 	VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	MemoryCategory memoryCategory = MemoryCategory::Other;
+	VkDeviceSize memorySize = 0;
 public:
 	VkImage handle;
 	Image(Device* device);
@@ -39,4 +41,5 @@ public:
 	void setTiling(VkImageTiling tiling);
 	void setUsage(VkImageUsageFlags usage);
 	void setSharingMode(VkSharingMode sharingMode);
+	void setMemoryCategory(MemoryCategory memoryCategory);
 };
\ No newline at end of file
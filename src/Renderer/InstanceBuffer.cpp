@@ -0,0 +1,47 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer(Device* device, VkDeviceSize frameSize, uint32_t frameCount)
+{
+	this->device = device;
+	this->frameSize = frameSize;
+	this->frameCount = frameCount;
+	// Host visible buffers are persistently mapped
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, frameSize * frameCount, nullptr, MemoryCategory::Geometry));
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	buffer.destroy();
+}
+
+// Returns a pointer to size bytes of the current frame's range and their offset into the buffer, or nullptr if the range is full
+void* InstanceBuffer::allocate(VkDeviceSize size, VkDeviceSize& offset)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	// Instance attributes are at most 16 byte aligned
+	const VkDeviceSize alignedOffset = (frameOffset + 15) & ~VkDeviceSize(15);
+	if (alignedOffset + size > frameSize) {
+		return nullptr;
+	}
+	frameOffset = alignedOffset + size;
+	offset = frameIndex * frameSize + alignedOffset;
+	stats.allocationsThisFrame++;
+	return static_cast<unsigned char*>(buffer.mapped) + offset;
+}
+
+// Advances to the next frame's range, call once the GPU is done with the frame that last used that range
+void InstanceBuffer::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frameIndex = (frameIndex + 1) % frameCount;
+	stats.bytesLastFrame = frameOffset;
+	stats.allocationsLastFrame = stats.allocationsThisFrame;
+	stats.allocationsThisFrame = 0;
+	frameOffset = 0;
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Buffer.h"
+
+// Host visible vertex buffer for the per-instance data of instanced draws
+// Instance data is written while recording the command buffer and bound at its offset, allocations are only valid for the current frame
+class InstanceBuffer
+{
+private:
+	Device* device;
+	std::mutex mutex;
+	VkDeviceSize frameSize;
+	uint32_t frameCount;
+	uint32_t frameIndex = 0;
+	VkDeviceSize frameOffset = 0;
+public:
+	Buffer buffer;
+	struct Stats {
+		VkDeviceSize bytesLastFrame = 0;
+		uint32_t allocationsLastFrame = 0;
+		uint32_t allocationsThisFrame = 0;
+	} stats;
+	InstanceBuffer(Device* device, VkDeviceSize frameSize, uint32_t frameCount);
+	~InstanceBuffer();
+	void* allocate(VkDeviceSize size, VkDeviceSize& offset);
+	void beginFrame();
+	// Reserves space for count instances of type T, returns nullptr if the frame's range is full
+	template<typename T> T* allocate(uint32_t count, VkDeviceSize& offset)
+	{
+		return static_cast<T*>(allocate(sizeof(T) * count, offset));
+	}
+};
@@ -0,0 +1,53 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "JobQueue.h"
+
+JobQueue::JobQueue(uint32_t threadCount)
+{
+	for (uint32_t i = 0; i < threadCount; i++) {
+		threads.push_back(std::thread(&JobQueue::worker, this));
+	}
+}
+
+JobQueue::~JobQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	condition.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void JobQueue::push(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	condition.notify_one();
+}
+
+void JobQueue::worker()
+{
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stop || !jobs.empty(); });
+			// Remaining jobs are finished before shutting down
+			if (stop && jobs.empty()) {
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
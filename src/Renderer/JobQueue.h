@@ -0,0 +1,30 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Simple FIFO job queue processed by a fixed number of worker threads
+class JobQueue
+{
+private:
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stop = false;
+	void worker();
+public:
+	JobQueue(uint32_t threadCount);
+	~JobQueue();
+	void push(std::function<void()> job);
+};
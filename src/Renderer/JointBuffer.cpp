@@ -0,0 +1,58 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "JointBuffer.h"
+
+#include <algorithm>
+
+JointBuffer::JointBuffer(Device* device, uint32_t maxJointCount, uint32_t frameCount)
+{
+	// Joint matrices are copied into the only copy of the buffer after waiting for the previous frame, which needs a single frame in flight
+	assert(frameCount == 1);
+	this->device = device;
+	this->maxJointCount = maxJointCount;
+	// Sized up front, as skins keep pointers to their matrices
+	jointMatrices.resize(maxJointCount, glm::mat4(1.0f));
+	// Host visible buffers are persistently mapped
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, (VkDeviceSize)sizeof(glm::mat4) * maxJointCount, nullptr, MemoryCategory::Uniforms));
+}
+
+JointBuffer::~JointBuffer()
+{
+	buffer.destroy();
+}
+
+// Reserves space for the given number of joint matrices and returns a pointer to them, returns nullptr if the buffer is full
+// Call setDirty after writing to the matrices
+glm::mat4* JointBuffer::allocate(uint32_t count, uint32_t& firstJoint)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (jointCount + count > maxJointCount) {
+		return nullptr;
+	}
+	firstJoint = jointCount;
+	jointCount += count;
+	return jointMatrices.data() + firstJoint;
+}
+
+// Marks the joint matrices for the copy in the next beginFrame
+void JointBuffer::setDirty(uint32_t firstJoint, uint32_t count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	dirtyBegin = std::min(dirtyBegin, firstJoint);
+	dirtyEnd = std::max(dirtyEnd, firstJoint + count);
+}
+
+// Copies the changed joint matrices to the buffer, call once the GPU is done with the previous frame
+void JointBuffer::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (dirtyBegin < dirtyEnd) {
+		memcpy(static_cast<glm::mat4*>(buffer.mapped) + dirtyBegin, jointMatrices.data() + dirtyBegin, (dirtyEnd - dirtyBegin) * sizeof(glm::mat4));
+	}
+	dirtyBegin = UINT32_MAX;
+	dirtyEnd = 0;
+}
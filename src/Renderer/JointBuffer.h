@@ -0,0 +1,41 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Buffer.h"
+
+#include <glm/glm.hpp>
+
+// Single host visible storage buffer that holds the joint matrices of all skins
+// Each skin gets a range of the buffer matching its joint count, so all skinned meshes can be drawn with a single binding
+// Allocations are linear and live as long as the buffer
+// Matrices are written to host memory and changed ranges are copied to the buffer in beginFrame, once the GPU is done reading it
+// The scene descriptor set binds a single copy of the buffer, so this only works with one frame in flight
+class JointBuffer
+{
+private:
+	Device* device;
+	std::mutex mutex;
+	uint32_t maxJointCount;
+	std::vector<glm::mat4> jointMatrices;
+	// Range of joints changed since the last copy
+	uint32_t dirtyBegin = UINT32_MAX;
+	uint32_t dirtyEnd = 0;
+public:
+	Buffer buffer;
+	uint32_t jointCount = 0;
+	JointBuffer(Device* device, uint32_t maxJointCount, uint32_t frameCount);
+	~JointBuffer();
+	glm::mat4* allocate(uint32_t count, uint32_t& firstJoint);
+	void setDirty(uint32_t firstJoint, uint32_t count);
+	void beginFrame();
+};
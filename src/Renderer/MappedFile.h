@@ -0,0 +1,28 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+private:
+#if defined(_WIN32)
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+public:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	~MappedFile();
+	bool open(std::string filename);
+	void close();
+};
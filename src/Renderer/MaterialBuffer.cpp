@@ -0,0 +1,39 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "MaterialBuffer.h"
+#include "UploadManager.h"
+
+MaterialBuffer::MaterialBuffer(Device* device, uint32_t materialSize, uint32_t maxMaterialCount)
+{
+	this->device = device;
+	this->materialSize = materialSize;
+	this->maxMaterialCount = maxMaterialCount;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &buffer, (VkDeviceSize)materialSize * maxMaterialCount, nullptr, MemoryCategory::Uniforms));
+}
+
+MaterialBuffer::~MaterialBuffer()
+{
+	buffer.destroy();
+}
+
+// Reserves space for the given number of materials, returns false if the buffer is full
+bool MaterialBuffer::allocate(uint32_t count, uint32_t& firstMaterial)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (materialCount + count > maxMaterialCount) {
+		return false;
+	}
+	firstMaterial = materialCount;
+	materialCount += count;
+	return true;
+}
+
+// Copies tightly packed material data into an allocated range via the batched staging arena
+void MaterialBuffer::upload(uint32_t firstMaterial, const void* data, uint32_t count)
+{
+	device->uploadManager->uploadBuffer(buffer.buffer, data, (VkDeviceSize)count * materialSize, (VkDeviceSize)firstMaterial * materialSize);
+}
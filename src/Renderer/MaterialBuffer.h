@@ -0,0 +1,32 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Buffer.h"
+
+// Single storage buffer that holds the precomputed shader parameters of all model materials
+// Materials are uploaded once at load time, draws only pass the index of their material
+// Allocations are linear and live as long as the buffer
+class MaterialBuffer
+{
+private:
+	Device* device;
+	std::mutex mutex;
+	uint32_t materialSize;
+	uint32_t maxMaterialCount;
+public:
+	Buffer buffer;
+	uint32_t materialCount = 0;
+	MaterialBuffer(Device* device, uint32_t materialSize, uint32_t maxMaterialCount);
+	~MaterialBuffer();
+	bool allocate(uint32_t count, uint32_t& firstMaterial);
+	void upload(uint32_t firstMaterial, const void* data, uint32_t count);
+};
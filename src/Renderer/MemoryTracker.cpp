@@ -0,0 +1,99 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <cassert>
+
+MemoryTracker::MemoryTracker(VmaAllocator allocator, const VkPhysicalDeviceMemoryProperties& memoryProperties, bool budgetExtension)
+{
+	this->allocator = allocator;
+	this->memoryProperties = memoryProperties;
+	this->budgetExtension = budgetExtension;
+	heapBudgets.resize(memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		heapBudgets[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+}
+
+// Allocations may be reported from the asset loading threads
+void MemoryTracker::allocate(MemoryCategory category, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	CategoryStats& stats = categories[(size_t)category];
+	stats.count++;
+	stats.bytes += size;
+	stats.peakCount = std::max(stats.peakCount, stats.count);
+	stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+	currentFrame.allocations++;
+}
+
+void MemoryTracker::free(MemoryCategory category, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	CategoryStats& stats = categories[(size_t)category];
+	assert((stats.count > 0) && (stats.bytes >= size));
+	stats.count--;
+	stats.bytes -= size;
+	currentFrame.frees++;
+}
+
+MemoryTracker::CategoryStats MemoryTracker::getCategoryStats(MemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return categories[(size_t)category];
+}
+
+// Usage and budget of all memory heaps as of the last beginFrame
+const std::vector<MemoryTracker::HeapBudget>& MemoryTracker::getHeapBudgets()
+{
+	return heapBudgets;
+}
+
+// Fetches current usage and budget of all memory heaps, also updates the heaps' high-water marks
+void MemoryTracker::updateHeapBudgets()
+{
+	VmaBudget vmaBudgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetBudget(allocator, vmaBudgets);
+	std::lock_guard<std::mutex> lock(mutex);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		heapBudgets[i].usage = vmaBudgets[i].usage;
+		heapBudgets[i].budget = vmaBudgets[i].budget;
+		heapBudgets[i].peakUsage = std::max(heapBudgets[i].peakUsage, heapBudgets[i].usage);
+	}
+}
+
+// Rolls the per-frame counters and lets VMA refresh its budget data
+void MemoryTracker::beginFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lastFrame = currentFrame;
+		currentFrame = {};
+		frameIndex++;
+	}
+	vmaSetCurrentFrameIndex(allocator, frameIndex);
+	updateHeapBudgets();
+}
+
+const char* MemoryTracker::getCategoryName(MemoryCategory category)
+{
+	switch (category) {
+	case MemoryCategory::Attachments:
+		return "Attachments";
+	case MemoryCategory::Geometry:
+		return "Geometry";
+	case MemoryCategory::Textures:
+		return "Textures";
+	case MemoryCategory::Uniforms:
+		return "Uniform/storage buffers";
+	case MemoryCategory::Staging:
+		return "Staging";
+	default:
+		return "Other";
+	}
+}
@@ -0,0 +1,68 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+
+// Purpose of a GPU allocation, used for the memory breakdown
+enum class MemoryCategory {
+	Attachments,
+	Geometry,
+	Textures,
+	Uniforms,
+	Staging,
+	Other,
+	Count
+};
+
+// Tracks GPU allocations per category and heap usage against the budget
+// Buffers created with Device::createBuffer, Image and texture allocations report here, so the breakdown only covers allocations made through those
+class MemoryTracker
+{
+public:
+	struct CategoryStats {
+		uint32_t count = 0;
+		VkDeviceSize bytes = 0;
+		uint32_t peakCount = 0;
+		VkDeviceSize peakBytes = 0;
+	};
+	struct HeapBudget {
+		VkDeviceSize usage = 0;
+		VkDeviceSize budget = 0;
+		VkDeviceSize peakUsage = 0;
+		bool deviceLocal = false;
+	};
+	struct FrameStats {
+		uint32_t allocations = 0;
+		uint32_t frees = 0;
+	};
+private:
+	std::mutex mutex;
+	VmaAllocator allocator;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	CategoryStats categories[(size_t)MemoryCategory::Count];
+	// Refreshed in beginFrame, kept as a member so the per-frame update doesn't allocate
+	std::vector<HeapBudget> heapBudgets;
+	FrameStats currentFrame;
+	uint32_t frameIndex = 0;
+public:
+	// True if heap usage and budget come from VK_EXT_memory_budget, otherwise they're estimated by VMA
+	bool budgetExtension;
+	FrameStats lastFrame;
+	MemoryTracker(VmaAllocator allocator, const VkPhysicalDeviceMemoryProperties& memoryProperties, bool budgetExtension);
+	void allocate(MemoryCategory category, VkDeviceSize size);
+	void free(MemoryCategory category, VkDeviceSize size);
+	CategoryStats getCategoryStats(MemoryCategory category);
+	const std::vector<HeapBudget>& getHeapBudgets();
+	void updateHeapBudgets();
+	void beginFrame();
+	static const char* getCategoryName(MemoryCategory category);
+};
@@ -0,0 +1,47 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "MeshBuffer.h"
+
+MeshBuffer::MeshBuffer(Device* device, uint32_t vertexStride, uint32_t maxVertexCount, uint32_t maxIndexCount, VkIndexType indexType)
+{
+	this->device = device;
+	this->vertexStride = vertexStride;
+	this->maxVertexCount = maxVertexCount;
+	this->maxIndexCount = maxIndexCount;
+	this->indexType = indexType;
+	const VkDeviceSize indexSize = (indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &vertices, (VkDeviceSize)vertexStride * maxVertexCount, nullptr, MemoryCategory::Geometry));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &indices, indexSize * maxIndexCount, nullptr, MemoryCategory::Geometry));
+}
+
+MeshBuffer::~MeshBuffer()
+{
+	vertices.destroy();
+	indices.destroy();
+}
+
+// Reserves space for the given number of vertices and indices, returns false if the buffers are full
+// Offsets are returned in vertices and indices, to be used as vertex offset and first index of indexed draws
+bool MeshBuffer::allocate(uint32_t vertexCount, uint32_t indexCount, uint32_t& vertexOffset, uint32_t& firstIndex)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if ((this->vertexCount + vertexCount > maxVertexCount) || (this->indexCount + indexCount > maxIndexCount)) {
+		return false;
+	}
+	vertexOffset = this->vertexCount;
+	firstIndex = this->indexCount;
+	this->vertexCount += vertexCount;
+	this->indexCount += indexCount;
+	return true;
+}
+
+void MeshBuffer::bind(VkCommandBuffer commandBuffer)
+{
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indexType);
+}
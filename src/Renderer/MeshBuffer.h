@@ -0,0 +1,37 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Buffer.h"
+
+// Single vertex and index buffer that static geometry of all models is suballocated from
+// Geometry only needs to be bound once, models are selected by vertex offset and first index of their draws
+// Allocations are linear and live as long as the buffer
+// All models sharing the buffer need to use the same index type
+class MeshBuffer
+{
+private:
+	Device* device;
+	std::mutex mutex;
+	uint32_t vertexStride;
+	uint32_t maxVertexCount;
+	uint32_t maxIndexCount;
+public:
+	Buffer vertices;
+	Buffer indices;
+	VkIndexType indexType;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	MeshBuffer(Device* device, uint32_t vertexStride, uint32_t maxVertexCount, uint32_t maxIndexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+	~MeshBuffer();
+	bool allocate(uint32_t vertexCount, uint32_t indexCount, uint32_t& vertexOffset, uint32_t& firstIndex);
+	void bind(VkCommandBuffer commandBuffer);
+};
@@ -0,0 +1,254 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "MeshOptimizer.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	// Size of the simulated cache used for triangle ordering
+	const int32_t VERTEX_CACHE_SIZE = 32;
+
+	// Vertex score for the linear speed vertex cache optimization by Tom Forsyth
+	// Vertices recently used and vertices with few remaining triangles are preferred
+	float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0) {
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			// The most recent triangle's vertices get a fixed score so they are not favored too much
+			score = (cachePosition < 3) ? 0.75f : powf(1.0f - (float)(cachePosition - 3) / (float)(VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+		return score + 2.0f * powf((float)remainingTriangles, -0.5f);
+	}
+}
+
+MeshOptimizer::Statistics MeshOptimizer::optimize(void* vertexData, uint32_t& vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices, const std::vector<Range>& ranges)
+{
+	Statistics statistics{};
+	statistics.vertexCountBefore = vertexCount;
+	statistics.acmrBefore = calculateACMR(indices.data(), indices.size());
+
+	uint8_t* vertices = static_cast<uint8_t*>(vertexData);
+	vertexCount = deduplicateVertices(vertices, vertexCount, vertexStride, indices);
+	for (const Range& range : ranges) {
+		if ((size_t)range.firstIndex + range.indexCount <= indices.size()) {
+			optimizeVertexCache(indices.data() + range.firstIndex, range.indexCount);
+		}
+	}
+	vertexCount = optimizeVertexFetch(vertices, vertexCount, vertexStride, indices);
+
+	statistics.vertexCountAfter = vertexCount;
+	statistics.acmrAfter = calculateACMR(indices.data(), indices.size());
+	return statistics;
+}
+
+// Simulates a FIFO post-transform cache and returns the number of cache misses per triangle
+float MeshOptimizer::calculateACMR(const uint32_t* indices, size_t indexCount, uint32_t cacheSize)
+{
+	if (indexCount < 3) {
+		return 0.0f;
+	}
+	std::vector<uint32_t> cache(cacheSize, UINT32_MAX);
+	uint32_t head = 0;
+	uint32_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		if (std::find(cache.begin(), cache.end(), indices[i]) == cache.end()) {
+			cache[head] = indices[i];
+			head = (head + 1) % cacheSize;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indexCount / 3);
+}
+
+// Merges vertices with identical data and returns the number of unique vertices
+uint32_t MeshOptimizer::deduplicateVertices(uint8_t* vertexData, uint32_t vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices)
+{
+	auto hash = [vertexData, vertexStride](uint32_t index) {
+		// 64-bit FNV-1a
+		const uint8_t* data = vertexData + (size_t)index * vertexStride;
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (uint32_t i = 0; i < vertexStride; i++) {
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+		return (size_t)hash;
+	};
+	auto equal = [vertexData, vertexStride](uint32_t a, uint32_t b) {
+		return memcmp(vertexData + (size_t)a * vertexStride, vertexData + (size_t)b * vertexStride, vertexStride) == 0;
+	};
+	std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)> uniqueVertices(vertexCount, hash, equal);
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> uniqueData;
+	uniqueData.reserve((size_t)vertexCount * vertexStride);
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		auto inserted = uniqueVertices.emplace(i, static_cast<uint32_t>(uniqueVertices.size()));
+		remap[i] = inserted.first->second;
+		if (inserted.second) {
+			uniqueData.insert(uniqueData.end(), vertexData + (size_t)i * vertexStride, vertexData + (size_t)(i + 1) * vertexStride);
+		}
+	}
+	memcpy(vertexData, uniqueData.data(), uniqueData.size());
+	for (uint32_t& index : indices) {
+		index = remap[index];
+	}
+	return static_cast<uint32_t>(uniqueData.size() / vertexStride);
+}
+
+// Reorders the triangles of an index range for post-transform vertex cache efficiency (Tom Forsyth's linear speed algorithm)
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (triangleCount < 2) {
+		return;
+	}
+
+	// Work on range local vertex ids
+	std::unordered_map<uint32_t, uint32_t> localIds;
+	std::vector<uint32_t> globalIds;
+	std::vector<uint32_t> localIndices(triangleCount * 3);
+	for (size_t i = 0; i < localIndices.size(); i++) {
+		auto inserted = localIds.emplace(indices[i], static_cast<uint32_t>(globalIds.size()));
+		if (inserted.second) {
+			globalIds.push_back(indices[i]);
+		}
+		localIndices[i] = inserted.first->second;
+	}
+	const uint32_t vertexCount = static_cast<uint32_t>(globalIds.size());
+
+	// Triangles adjacent to each vertex, the first remainingTriangles entries of a vertex are the ones not yet emitted
+	std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+	for (uint32_t index : localIndices) {
+		remainingTriangles[index]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(localIndices.size());
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (uint32_t k = 0; k < 3; k++) {
+				adjacency[fill[localIndices[t * 3 + k]]++] = t;
+			}
+		}
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	int32_t bestTriangle = 0;
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		triangleScores[t] = vertexScores[localIndices[t * 3]] + vertexScores[localIndices[t * 3 + 1]] + vertexScores[localIndices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle]) {
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	std::vector<uint32_t> result;
+	result.reserve(localIndices.size());
+	uint32_t scanPosition = 0;
+	while (result.size() < localIndices.size()) {
+		if (bestTriangle < 0) {
+			// Nothing in the cache has triangles left, continue with the next triangle in original order
+			while (emitted[scanPosition]) {
+				scanPosition++;
+			}
+			bestTriangle = scanPosition;
+		}
+		emitted[bestTriangle] = true;
+		const uint32_t* triangle = &localIndices[bestTriangle * 3];
+
+		newCache.clear();
+		for (uint32_t k = 0; k < 3; k++) {
+			const uint32_t v = triangle[k];
+			result.push_back(v);
+			// Remove the triangle from the vertex' list of remaining triangles
+			uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; i++) {
+				if (triangles[i] == (uint32_t)bestTriangle) {
+					std::swap(triangles[i], triangles[remainingTriangles[v] - 1]);
+					remainingTriangles[v]--;
+					break;
+				}
+			}
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+		for (uint32_t v : cache) {
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+
+		// Update scores of all vertices whose cache position changed and pick the best triangle using them
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < newCache.size(); i++) {
+			const uint32_t v = newCache[i];
+			cachePositions[v] = (i < (uint32_t)VERTEX_CACHE_SIZE) ? (int32_t)i : -1;
+			const float score = vertexScore(cachePositions[v], remainingTriangles[v]);
+			const float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			const uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+				triangleScores[triangles[j]] += delta;
+			}
+		}
+		for (uint32_t i = 0; i < newCache.size() && i < (uint32_t)VERTEX_CACHE_SIZE; i++) {
+			const uint32_t v = newCache[i];
+			const uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+				if (triangleScores[triangles[j]] > bestScore) {
+					bestScore = triangleScores[triangles[j]];
+					bestTriangle = triangles[j];
+				}
+			}
+		}
+		if (newCache.size() > (size_t)VERTEX_CACHE_SIZE) {
+			newCache.resize(VERTEX_CACHE_SIZE);
+		}
+		std::swap(cache, newCache);
+	}
+
+	for (size_t i = 0; i < result.size(); i++) {
+		indices[i] = globalIds[result[i]];
+	}
+}
+
+// Reorders vertices in the order they are first referenced by the index buffer, unreferenced vertices are removed
+uint32_t MeshOptimizer::optimizeVertexFetch(uint8_t* vertexData, uint32_t vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	std::vector<uint8_t> orderedData;
+	orderedData.reserve((size_t)vertexCount * vertexStride);
+	uint32_t nextVertex = 0;
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = nextVertex++;
+			orderedData.insert(orderedData.end(), vertexData + (size_t)index * vertexStride, vertexData + (size_t)(index + 1) * vertexStride);
+		}
+		index = remap[index];
+	}
+	memcpy(vertexData, orderedData.data(), orderedData.size());
+	return nextVertex;
+}
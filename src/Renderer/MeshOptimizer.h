@@ -0,0 +1,37 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// Optimizes indexed triangle meshes for rendering
+// Removes duplicate vertices, reorders triangles for post-transform vertex cache hits and vertices for fetch locality
+class MeshOptimizer
+{
+public:
+	// Contiguous part of the index buffer (e.g. a primitive), triangles are only reordered within their range
+	struct Range {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+	struct Statistics {
+		uint32_t vertexCountBefore = 0;
+		uint32_t vertexCountAfter = 0;
+		// Average cache miss ratio (transformed vertices per triangle) of a simulated FIFO cache
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+	};
+	// Vertices are tightly packed with the given stride, vertexCount is updated to the number of remaining vertices
+	static Statistics optimize(void* vertexData, uint32_t& vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices, const std::vector<Range>& ranges);
+	static float calculateACMR(const uint32_t* indices, size_t indexCount, uint32_t cacheSize = 16);
+private:
+	static uint32_t deduplicateVertices(uint8_t* vertexData, uint32_t vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices);
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount);
+	static uint32_t optimizeVertexFetch(uint8_t* vertexData, uint32_t vertexCount, uint32_t vertexStride, std::vector<uint32_t>& indices);
+};
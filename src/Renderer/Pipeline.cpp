@@ -11,17 +11,41 @@ Pipeline::Pipeline(VkDevice device) {
 }
 
 Pipeline::~Pipeline() {
-	// @todo: destroy shader modules
+	releaseShaderStages();
 	vkDestroyPipeline(device, pso, nullptr);
 }
 
 void Pipeline::create() {
+	VkGraphicsPipelineCreateInfo createInfo = getCreateInfo();
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, cache, 1, &createInfo, nullptr, &pso));
+	releaseShaderStages();
+}
+
+// Shader stages are only needed for creation, cached modules may be released by the asset manager afterwards
+void Pipeline::releaseShaderStages() {
+	for (auto shaderModule : ownedShaderModules) {
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+	ownedShaderModules.clear();
+	shaderStages.clear();
+}
+
+// Returns the final create info including shader stages, layout and render pass
+// Can be used to create multiple pipelines with a single call (see setHandle)
+VkGraphicsPipelineCreateInfo Pipeline::getCreateInfo() {
 	assert(layout);
+	assert(!shaderStages.empty());
 	pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 	pipelineCI.pStages = shaderStages.data();
 	pipelineCI.layout = layout->handle;
 	pipelineCI.renderPass = renderPass->handle;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, cache, 1, &pipelineCI, nullptr, &pso));
+	return pipelineCI;
+}
+
+void Pipeline::setHandle(VkPipeline pso) {
+	assert(this->pso == VK_NULL_HANDLE);
+	this->pso = pso;
+	releaseShaderStages();
 }
 
 void Pipeline::addShader(std::string filename) {
@@ -38,9 +62,12 @@ void Pipeline::addShader(std::string filename) {
 	shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStageCI.stage = shaderStage;
 	shaderStageCI.pName = "main";
-	shaderStageCI.module = assetManager->loadShaderShaderModule(filename);
+	bool cached;
+	shaderStageCI.module = assetManager->loadShaderShaderModule(filename, cached);
 	assert(shaderStageCI.module != VK_NULL_HANDLE);
-	shaderModules.push_back(shaderStageCI.module);
+	if (!cached) {
+		ownedShaderModules.push_back(shaderStageCI.module);
+	}
 	shaderStages.push_back(shaderStageCI);
 }
 
@@ -61,6 +88,14 @@ void Pipeline::setCache(VkPipelineCache cache) {
 	this->cache = cache;
 }
 
+void Pipeline::setModelVertexFormat(vkglTF::Model::VertexFormat vertexFormat) {
+	this->modelVertexFormat = vertexFormat;
+}
+
+vkglTF::Model::VertexFormat Pipeline::getModelVertexFormat() {
+	return modelVertexFormat;
+}
+
 VkPipelineBindPoint Pipeline::getBindPoint() {
 	return bindPoint;
 }
@@ -25,16 +25,24 @@ private:
 	VkGraphicsPipelineCreateInfo pipelineCI;
 	VkPipelineCache cache;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
-	std::vector<VkShaderModule> shaderModules;
+	// Vertex layout of the models drawn with this pipeline
+	vkglTF::Model::VertexFormat modelVertexFormat = vkglTF::Model::VERTEX_FORMAT_FULL;
+	// Modules not owned by the shader module cache, destroyed once the pipeline has been created
+	std::vector<VkShaderModule> ownedShaderModules;
+	void releaseShaderStages();
 public:
 	Pipeline(VkDevice device);
 	~Pipeline();
 	void create();
+	VkGraphicsPipelineCreateInfo getCreateInfo();
+	void setHandle(VkPipeline pso);
 	void addShader(std::string filename);
 	void setLayout(PipelineLayout* layout);
 	void setRenderPass(RenderPass* renderPass);
 	void setCreateInfo(VkGraphicsPipelineCreateInfo pipelineCI);
 	void setCache(VkPipelineCache cache);
+	void setModelVertexFormat(vkglTF::Model::VertexFormat vertexFormat);
+	vkglTF::Model::VertexFormat getModelVertexFormat();
 	VkPipelineBindPoint getBindPoint();
 	VkPipeline getHandle();
 };
@@ -5,6 +5,7 @@
  */
 
 #include "Sampler.h"
+#include "SamplerCache.h"
 
 Sampler::Sampler(Device* device)
 {
@@ -13,7 +14,7 @@ Sampler::Sampler(Device* device)
 
 Sampler::~Sampler()
 {
-    vkDestroySampler(device->handle, handle, nullptr);
+    device->samplerCache->release(handle);
 }
 
 void Sampler::create()
@@ -28,7 +29,8 @@ void Sampler::create()
     CI.magFilter = magFilter;
     CI.maxAnisotropy = maxAnisotropy;
     CI.anisotropyEnable = (maxAnisotropy > 0.0f);
-    VK_CHECK_RESULT(vkCreateSampler(device->handle, &CI, nullptr, &handle));
+    CI.mipmapMode = mipmapMode;
+    handle = device->samplerCache->acquire(CI);
 }
 
 void Sampler::setMinFilter(VkFilter minFilter)
@@ -15,16 +15,17 @@ class Sampler
 {
 private:
     Device* device;
-    VkFilter magFilter;
-    VkFilter minFilter;
-    VkSamplerMipmapMode mipmapMode;
-    VkSamplerAddressMode addressModeU;
-    VkSamplerAddressMode addressModeV;
-    VkSamplerAddressMode addressModeW;
-    VkBorderColor borderColor;
-    float maxAnisotropy;
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkBorderColor borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    float maxAnisotropy = 0.0f;
 public:
-    VkSampler handle;
+    // Shared with other samplers of the same state, see SamplerCache
+    VkSampler handle = VK_NULL_HANDLE;
     Sampler(Device* device);
     ~Sampler();
     void setMinFilter(VkFilter minFilter);
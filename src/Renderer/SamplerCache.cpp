@@ -0,0 +1,101 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "SamplerCache.h"
+
+#include <cstring>
+
+bool SamplerCache::SamplerKey::operator==(const SamplerKey& other) const
+{
+	return memcmp(this, &other, sizeof(SamplerKey)) == 0;
+}
+
+size_t SamplerCache::SamplerKeyHash::operator()(const SamplerKey& key) const
+{
+	// 64-bit FNV-1a, the key only consists of 32 bit members so there is no padding
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(&key);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < sizeof(SamplerKey); i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return (size_t)hash;
+}
+
+SamplerCache::SamplerCache(Device* device)
+{
+	this->device = device;
+}
+
+SamplerCache::~SamplerCache()
+{
+	for (auto& sampler : samplers) {
+		vkDestroySampler(device->handle, sampler.second.sampler, nullptr);
+	}
+}
+
+// Returns a sampler matching the create info, the sampler is only created if no identical one exists yet
+VkSampler SamplerCache::acquire(const VkSamplerCreateInfo& createInfo)
+{
+	assert(createInfo.pNext == nullptr);
+	SamplerKey key{};
+	key.flags = createInfo.flags;
+	key.magFilter = createInfo.magFilter;
+	key.minFilter = createInfo.minFilter;
+	key.mipmapMode = createInfo.mipmapMode;
+	key.addressModeU = createInfo.addressModeU;
+	key.addressModeV = createInfo.addressModeV;
+	key.addressModeW = createInfo.addressModeW;
+	key.mipLodBias = createInfo.mipLodBias;
+	key.anisotropyEnable = createInfo.anisotropyEnable;
+	// Ignored by Vulkan if anisotropic filtering is disabled, so don't create different samplers for it
+	key.maxAnisotropy = createInfo.anisotropyEnable ? createInfo.maxAnisotropy : 1.0f;
+	key.compareEnable = createInfo.compareEnable;
+	key.compareOp = createInfo.compareEnable ? createInfo.compareOp : VK_COMPARE_OP_NEVER;
+	key.minLod = createInfo.minLod;
+	key.maxLod = createInfo.maxLod;
+	key.borderColor = createInfo.borderColor;
+	key.unnormalizedCoordinates = createInfo.unnormalizedCoordinates;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto cached = samplers.find(key);
+	if (cached != samplers.end()) {
+		cached->second.references++;
+		return cached->second.sampler;
+	}
+	VkSampler sampler;
+	VK_CHECK_RESULT(vkCreateSampler(device->handle, &createInfo, nullptr, &sampler));
+	samplers[key] = { sampler, 1 };
+	samplerKeys[sampler] = key;
+	return sampler;
+}
+
+// Drops a reference to a sampler returned by acquire, the sampler is destroyed once it's no longer referenced
+void SamplerCache::release(VkSampler sampler)
+{
+	if (sampler == VK_NULL_HANDLE) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	auto key = samplerKeys.find(sampler);
+	if (key == samplerKeys.end()) {
+		std::cerr << "Released sampler is not owned by the sampler cache\n";
+		return;
+	}
+	auto cached = samplers.find(key->second);
+	if (--cached->second.references == 0) {
+		vkDestroySampler(device->handle, sampler, nullptr);
+		samplers.erase(cached);
+		samplerKeys.erase(key);
+	}
+}
+
+// Number of unique samplers currently alive
+uint32_t SamplerCache::getSamplerCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<uint32_t>(samplers.size());
+}
@@ -0,0 +1,58 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "Device.h"
+
+// Hands out shared samplers, so identical sampler states only create a single Vulkan sampler
+// Samplers are keyed on their full create info and reference counted, release every acquired sampler once it's no longer used
+class SamplerCache
+{
+private:
+	// All sampler state of VkSamplerCreateInfo, extension structures are not supported
+	struct SamplerKey {
+		VkSamplerCreateFlags flags;
+		VkFilter magFilter;
+		VkFilter minFilter;
+		VkSamplerMipmapMode mipmapMode;
+		VkSamplerAddressMode addressModeU;
+		VkSamplerAddressMode addressModeV;
+		VkSamplerAddressMode addressModeW;
+		float mipLodBias;
+		VkBool32 anisotropyEnable;
+		float maxAnisotropy;
+		VkBool32 compareEnable;
+		VkCompareOp compareOp;
+		float minLod;
+		float maxLod;
+		VkBorderColor borderColor;
+		VkBool32 unnormalizedCoordinates;
+		bool operator==(const SamplerKey& other) const;
+	};
+	struct SamplerKeyHash {
+		size_t operator()(const SamplerKey& key) const;
+	};
+	struct CachedSampler {
+		VkSampler sampler;
+		uint32_t references;
+	};
+	Device* device;
+	std::mutex mutex;
+	std::unordered_map<SamplerKey, CachedSampler, SamplerKeyHash> samplers;
+	std::unordered_map<VkSampler, SamplerKey> samplerKeys;
+public:
+	SamplerCache(Device* device);
+	~SamplerCache();
+	VkSampler acquire(const VkSamplerCreateInfo& createInfo);
+	void release(VkSampler sampler);
+	uint32_t getSamplerCount();
+};
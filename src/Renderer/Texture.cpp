@@ -7,6 +7,10 @@
 */
 
 #include "Texture.h"
+#include "UploadManager.h"
+#include "SamplerCache.h"
+
+#include <algorithm>
 
 void Texture::updateDescriptor()
 {
@@ -21,9 +25,13 @@ void Texture::destroy()
 	vkDestroyImage(device->handle, image, nullptr);
 	if (sampler)
 	{
-		vkDestroySampler(device->handle, sampler, nullptr);
+		device->samplerCache->release(sampler);
 	}
 	vkFreeMemory(device->handle, deviceMemory, nullptr);
+	if (memorySize > 0) {
+		device->memoryTracker->free(MemoryCategory::Textures, memorySize);
+		memorySize = 0;
+	}
 }
 
 ktxResult Texture::loadKTXFile(std::string filename, ktxTexture** target)
@@ -47,12 +55,74 @@ ktxResult Texture::loadKTXFile(std::string filename, ktxTexture** target)
 	return result;
 }
 
+// Block compressed format family used for textures on this device, BC is preferred over ETC2 and ASTC
+// Returns FORMAT_RGBA8 if none of the texture compression features is enabled
+TextureCache::Format Texture::getCompressionFormat(Device* device)
+{
+	if (device->enabledFeatures.textureCompressionBC) {
+		return TextureCache::FORMAT_BC;
+	}
+	if (device->enabledFeatures.textureCompressionETC2) {
+		return TextureCache::FORMAT_ETC2;
+	}
+	if (device->enabledFeatures.textureCompressionASTC_LDR) {
+		return TextureCache::FORMAT_ASTC;
+	}
+	return TextureCache::FORMAT_RGBA8;
+}
+
+// Replaces an uncompressed RGBA8 texture with a block compressed version if the device supports a compressed format
+// The result is cached next to the source file, so encoding only happens on the first load
+// Encoding is costly, so this should be called on a worker thread
+bool Texture::compressKTXTexture(ktxTexture** target, Device* device, const std::string& filename)
+{
+	ktxTexture* source = *target;
+	const TextureCache::Format format = getCompressionFormat(device);
+	if ((format == TextureCache::FORMAT_RGBA8) || (ktxTexture_GetVkFormat(source) != VK_FORMAT_R8G8B8A8_UNORM) || (source->numDimensions != 2) || (source->numLayers != 1) || (source->numFaces != 1)) {
+		return false;
+	}
+	// Not worth it for textures smaller than a single block
+	if ((source->baseWidth < 4) || (source->baseHeight < 4)) {
+		return false;
+	}
+	std::vector<const unsigned char*> levels(source->numLevels);
+	for (uint32_t i = 0; i < source->numLevels; i++) {
+		ktx_size_t offset;
+		KTX_error_code result = ktxTexture_GetImageOffset(source, i, 0, 0, &offset);
+		assert(result == KTX_SUCCESS);
+		levels[i] = ktxTexture_GetData(source) + offset;
+	}
+	// Cache files are named after the image data, so changed files never pick up stale results
+	const std::string cacheFilename = TextureCache::getFilename(TextureCache::getDirectory(filename), ktxTexture_GetData(source), ktxTexture_GetDataSize(source), format);
+	std::vector<unsigned char> compressedData;
+	uint32_t width, height;
+	if (!TextureCache::load(cacheFilename, compressedData, width, height)) {
+		TextureCache::compress(levels, source->baseWidth, source->baseHeight, format, compressedData);
+		if (TextureCache::write(cacheFilename, compressedData)) {
+			std::clog << "Texture " + filename + " compressed to " + cacheFilename + "\n";
+		}
+	}
+	ktxTexture* compressed;
+	if (ktxTexture_CreateFromMemory(compressedData.data(), compressedData.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &compressed) != KTX_SUCCESS) {
+		return false;
+	}
+	ktxTexture_Destroy(source);
+	*target = compressed;
+	return true;
+}
+
 void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 {
 	ktxTexture* ktxTexture;
 	ktxResult result = loadKTXFile(filename, &ktxTexture);
 	assert(result == KTX_SUCCESS);
+	loadFromKTXTexture(ktxTexture, device, copyQueue, imageUsageFlags, imageLayout);
+}
 
+// Uploads an already loaded KTX texture, allows for decoding the file on a different thread than the upload
+// Takes ownership of the passed texture
+void Texture2D::loadFromKTXTexture(ktxTexture* ktxTexture, Device* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+{
 	this->device = device;
 	width = ktxTexture->baseWidth;
 	height = ktxTexture->baseHeight;
@@ -69,23 +139,6 @@ void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQ
 	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 	VkMemoryRequirements memReqs;
 
-	// Use a separate command buffer for texture loading
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-	// Copy image data to staging buffer
-	VkBuffer stagingBuffer;
-	VkBufferCreateInfo bufferCI{};
-	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCI.size = ktxTextureSize;
-	VmaAllocationCreateInfo allocCI{};
-	allocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-	allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-	VmaAllocation alloc{};
-	VmaAllocationInfo allocInfo{};
-	VK_CHECK_RESULT(vmaCreateBuffer(device->vmaAllocator, &bufferCI, &allocCI, &stagingBuffer, &alloc, &allocInfo));
-	memcpy(allocInfo.pMappedData, ktxTextureData, ktxTextureSize);
-
 	// Setup buffer copy regions for each mip level
 	std::vector<VkBufferImageCopy> bufferCopyRegions;
 
@@ -100,8 +153,9 @@ void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQ
 		bufferCopyRegion.imageSubresource.mipLevel = i;
 		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> i;
-		bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> i;
+		// Mip levels of non-square textures are at least one texel wide
+		bufferCopyRegion.imageExtent.width = std::max(ktxTexture->baseWidth >> i, 1u);
+		bufferCopyRegion.imageExtent.height = std::max(ktxTexture->baseHeight >> i, 1u);
 		bufferCopyRegion.imageExtent.depth = 1;
 		bufferCopyRegion.bufferOffset = offset;
 
@@ -130,6 +184,8 @@ void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQ
 	memAllocInfo.allocationSize = memReqs.size;
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAllocInfo, nullptr, &deviceMemory));
+	memorySize = memReqs.size;
+	device->memoryTracker->allocate(MemoryCategory::Textures, memorySize);
 	VK_CHECK_RESULT(vkBindImageMemory(device->handle, image, deviceMemory, 0));
 
 	VkImageSubresourceRange subresourceRange = {};
@@ -138,37 +194,10 @@ void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQ
 	subresourceRange.levelCount = mipLevels;
 	subresourceRange.layerCount = 1;
 
-	// Image barrier for optimal image (target)
-	// Optimal image will be used as destination for the copy
-	vks::tools::setImageLayout(
-		copyCmd,
-		image,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		subresourceRange);
-
-	// Copy mip levels from staging buffer
-	vkCmdCopyBufferToImage(
-		copyCmd,
-		stagingBuffer,
-		image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		static_cast<uint32_t>(bufferCopyRegions.size()),
-		bufferCopyRegions.data()
-	);
-
-	// Change texture image layout to shader read after all mip levels have been copied
+	// Copy mip levels from staging and transition the image for shader reads
+	// Uploads are batched, the upload manager's queue ensures they have finished before the texture is used by later submissions
 	this->imageLayout = imageLayout;
-	vks::tools::setImageLayout(
-		copyCmd,
-		image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		imageLayout,
-		subresourceRange);
-
-	device->flushCommandBuffer(copyCmd, copyQueue);
-
-	vmaDestroyBuffer(device->vmaAllocator, stagingBuffer, alloc);
+	device->uploadManager->uploadImage(image, ktxTextureData, ktxTextureSize, bufferCopyRegions, subresourceRange, imageLayout);
 	ktxTexture_Destroy(ktxTexture);
 
 	// Create a defaultsampler
@@ -183,13 +212,13 @@ void Texture2D::loadFromFile(std::string filename, Device* device, VkQueue copyQ
 	samplerCreateInfo.mipLodBias = 0.0f;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.minLod = 0.0f;
-	// Max level-of-detail should match mip level count
-	samplerCreateInfo.maxLod = (float)mipLevels;
+	// Not clamped to the texture's mip count, the image view limits the levels and textures of all sizes can share the sampler
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 	// Only enable anisotropic filtering if enabled on the device
 	samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
 	samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	VK_CHECK_RESULT(vkCreateSampler(device->handle, &samplerCreateInfo, nullptr, &sampler));
+	sampler = device->samplerCache->acquire(samplerCreateInfo);
 
 	// Create image view
 	// Textures are not directly accessed by the shaders and
@@ -242,6 +271,7 @@ void Texture2DArray::loadFromFile(std::string filename, Device* device, VkQueue
 	VmaAllocation alloc{};
 	VmaAllocationInfo allocInfo{};
 	VK_CHECK_RESULT(vmaCreateBuffer(device->vmaAllocator, &bufferCI, &allocCI, &stagingBuffer, &alloc, &allocInfo));
+	device->memoryTracker->allocate(MemoryCategory::Staging, allocInfo.size);
 	memcpy(allocInfo.pMappedData, ktxTextureData, ktxTextureSize);
 
 	// Setup buffer copy regions for each layer including all of it's miplevels
@@ -295,6 +325,8 @@ void Texture2DArray::loadFromFile(std::string filename, Device* device, VkQueue
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAllocInfo, nullptr, &deviceMemory));
+	memorySize = memReqs.size;
+	device->memoryTracker->allocate(MemoryCategory::Textures, memorySize);
 	VK_CHECK_RESULT(vkBindImageMemory(device->handle, image, deviceMemory, 0));
 
 	// Use a separate command buffer for texture loading
@@ -348,9 +380,9 @@ void Texture2DArray::loadFromFile(std::string filename, Device* device, VkQueue
 	samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.minLod = 0.0f;
-	samplerCreateInfo.maxLod = (float)mipLevels;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	VK_CHECK_RESULT(vkCreateSampler(device->handle, &samplerCreateInfo, nullptr, &sampler));
+	sampler = device->samplerCache->acquire(samplerCreateInfo);
 
 	// Create image view
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -365,6 +397,7 @@ void Texture2DArray::loadFromFile(std::string filename, Device* device, VkQueue
 
 	// Clean up staging resources
 	vmaDestroyBuffer(device->vmaAllocator, stagingBuffer, alloc);
+	device->memoryTracker->free(MemoryCategory::Staging, allocInfo.size);
 	ktxTexture_Destroy(ktxTexture);
 
 	// Update descriptor image info member that can be used for setting up descriptor sets
@@ -401,6 +434,7 @@ void TextureCubeMap::loadFromFile(std::string filename, Device* device, VkQueue
 	VmaAllocation alloc{};
 	VmaAllocationInfo allocInfo{};
 	VK_CHECK_RESULT(vmaCreateBuffer(device->vmaAllocator, &bufferCI, &allocCI, &stagingBuffer, &alloc, &allocInfo));
+	device->memoryTracker->allocate(MemoryCategory::Staging, allocInfo.size);
 	memcpy(allocInfo.pMappedData, ktxTextureData, ktxTextureSize);
 
 	// Setup buffer copy regions for each face including all of it's miplevels
@@ -458,6 +492,8 @@ void TextureCubeMap::loadFromFile(std::string filename, Device* device, VkQueue
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAllocInfo, nullptr, &deviceMemory));
+	memorySize = memReqs.size;
+	device->memoryTracker->allocate(MemoryCategory::Textures, memorySize);
 	VK_CHECK_RESULT(vkBindImageMemory(device->handle, image, deviceMemory, 0));
 
 	// Use a separate command buffer for texture loading
@@ -511,9 +547,9 @@ void TextureCubeMap::loadFromFile(std::string filename, Device* device, VkQueue
 	samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.minLod = 0.0f;
-	samplerCreateInfo.maxLod = (float)mipLevels;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	VK_CHECK_RESULT(vkCreateSampler(device->handle, &samplerCreateInfo, nullptr, &sampler));
+	sampler = device->samplerCache->acquire(samplerCreateInfo);
 
 	// Create image view
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -528,6 +564,7 @@ void TextureCubeMap::loadFromFile(std::string filename, Device* device, VkQueue
 
 	// Clean up staging resources
 	vmaDestroyBuffer(device->vmaAllocator, stagingBuffer, alloc);
+	device->memoryTracker->free(MemoryCategory::Staging, allocInfo.size);
 	vkDestroyBuffer(device->handle, stagingBuffer, nullptr);
 
 	// Update descriptor image info member that can be used for setting up descriptor sets
@@ -21,6 +21,7 @@
 #include "VulkanTools.h"
 #include "Device.h"
 #include "Buffer.h"
+#include "TextureCache.h"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -33,6 +34,8 @@ public:
 	VkImage image;
 	VkImageLayout imageLayout;
 	VkDeviceMemory deviceMemory;
+	// Size of deviceMemory as reported to the device's memory tracker
+	VkDeviceSize memorySize = 0;
 	VkImageView view;
 	uint32_t width, height;
 	uint32_t mipLevels;
@@ -42,11 +45,14 @@ public:
 	void updateDescriptor();
 	void destroy();
 	ktxResult loadKTXFile(std::string filename, ktxTexture** target);
+	static TextureCache::Format getCompressionFormat(Device* device);
+	static bool compressKTXTexture(ktxTexture** target, Device* device, const std::string& filename);
 };
 
 class Texture2D : public Texture
 {
 public:
+	void loadFromKTXTexture(ktxTexture* ktxTexture, Device* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	void loadFromFile(std::string filename, Device* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 };
 
@@ -0,0 +1,336 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "TextureCache.h"
+#include "BlockCompressor.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <cassert>
+
+#include "stb_image.h"
+// Only used for the zlib compressor
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBI_WRITE_NO_STDIO
+#include "stb_image_write.h"
+
+namespace
+{
+	// Bump the version whenever the conversion changes, so stale cache files are no longer picked up
+	const uint32_t TEXTURE_CACHE_VERSION = 2;
+
+	const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const uint32_t KTX_ENDIANNESS = 0x04030201;
+	const uint32_t GL_UNSIGNED_BYTE_TYPE = 0x1401;
+	const uint32_t GL_RGBA_FORMAT = 0x1908;
+	const uint32_t GL_RGB_FORMAT = 0x1907;
+	const uint32_t GL_RGBA8_FORMAT = 0x8058;
+	const uint32_t GL_COMPRESSED_BC1_FORMAT = 0x83F0;
+	const uint32_t GL_COMPRESSED_BC7_FORMAT = 0x8E8C;
+	const uint32_t GL_COMPRESSED_ETC2_RGB_FORMAT = 0x9274;
+	const uint32_t GL_COMPRESSED_ETC2_RGBA_FORMAT = 0x9278;
+	const uint32_t GL_COMPRESSED_ASTC_4x4_FORMAT = 0x93B0;
+
+	bool isCacheFormat(uint32_t glInternalFormat)
+	{
+		const uint32_t formats[] = { GL_RGBA8_FORMAT, GL_COMPRESSED_BC1_FORMAT, GL_COMPRESSED_BC7_FORMAT, GL_COMPRESSED_ETC2_RGB_FORMAT, GL_COMPRESSED_ETC2_RGBA_FORMAT, GL_COMPRESSED_ASTC_4x4_FORMAT };
+		return std::find(std::begin(formats), std::end(formats), glInternalFormat) != std::end(formats);
+	}
+
+	struct KTXHeader {
+		unsigned char identifier[12];
+		uint32_t endianness;
+		uint32_t glType;
+		uint32_t glTypeSize;
+		uint32_t glFormat;
+		uint32_t glInternalFormat;
+		uint32_t glBaseInternalFormat;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t numberOfArrayElements;
+		uint32_t numberOfFaces;
+		uint32_t numberOfMipmapLevels;
+		uint32_t bytesOfKeyValueData;
+	};
+}
+
+// Cache files are stored in a folder next to the source file
+std::string TextureCache::getDirectory(const std::string& filename)
+{
+	return (std::filesystem::path(filename).parent_path() / "texturecache").string();
+}
+
+std::string TextureCache::getFilename(const std::string& directory, const unsigned char* data, size_t size, Format format)
+{
+	// 64-bit FNV-1a of the source data, seeded with the cache version
+	uint64_t hash = 0xcbf29ce484222325ull ^ TEXTURE_CACHE_VERSION;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	std::stringstream name;
+	const char* suffixes[] = { ".ktx.z", "_bc.ktx", "_etc2.ktx", "_astc.ktx" };
+	name << std::hex << std::setw(16) << std::setfill('0') << hash << "_" << std::dec << size << suffixes[format];
+	return (std::filesystem::path(directory) / name.str()).string();
+}
+
+// Reads a cached KTX file and checks that it's a complete texture in one of the formats written by this cache
+// Files that don't start with the KTX identifier are supercompressed and inflated first
+bool TextureCache::load(const std::string& filename, std::vector<unsigned char>& ktxData, uint32_t& width, uint32_t& height)
+{
+	std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+	if (!stream.is_open()) {
+		return false;
+	}
+	const size_t size = static_cast<size_t>(stream.tellg());
+	if (size < sizeof(KTX_IDENTIFIER)) {
+		return false;
+	}
+	ktxData.resize(size);
+	stream.seekg(0);
+	stream.read(reinterpret_cast<char*>(ktxData.data()), size);
+	if (!stream.good()) {
+		return false;
+	}
+	if (memcmp(ktxData.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) {
+		int inflatedSize;
+		char* inflated = stbi_zlib_decode_malloc(reinterpret_cast<const char*>(ktxData.data()), static_cast<int>(size), &inflatedSize);
+		if (!inflated) {
+			return false;
+		}
+		ktxData.assign(inflated, inflated + inflatedSize);
+		free(inflated);
+	}
+	if (ktxData.size() < sizeof(KTXHeader)) {
+		return false;
+	}
+	const size_t dataSize = ktxData.size();
+	KTXHeader header;
+	memcpy(&header, ktxData.data(), sizeof(header));
+	if ((memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) || (header.endianness != KTX_ENDIANNESS) || !isCacheFormat(header.glInternalFormat) || (header.pixelWidth == 0) || (header.pixelHeight == 0)) {
+		return false;
+	}
+	// Walk the mip levels to make sure the file hasn't been truncated
+	size_t offset = sizeof(KTXHeader) + header.bytesOfKeyValueData;
+	for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++) {
+		uint32_t imageSize;
+		if (offset + sizeof(imageSize) > dataSize) {
+			return false;
+		}
+		memcpy(&imageSize, ktxData.data() + offset, sizeof(imageSize));
+		offset += sizeof(imageSize) + ((imageSize + 3) & ~3u);
+	}
+	if ((header.numberOfMipmapLevels == 0) || (offset > dataSize)) {
+		return false;
+	}
+	width = header.pixelWidth;
+	height = header.pixelHeight;
+	return true;
+}
+
+// Decodes a source image and stores it as KTX with a full mip chain in memory
+bool TextureCache::convert(const unsigned char* data, size_t size, std::vector<unsigned char>& ktxData, uint32_t& width, uint32_t& height)
+{
+	int w, h, components;
+	// Always expand to RGBA, most devices don't support RGB only on Vulkan
+	unsigned char* pixels = stbi_load_from_memory(data, static_cast<int>(size), &w, &h, &components, STBI_rgb_alpha);
+	if (!pixels) {
+		return false;
+	}
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+	std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+
+	const uint32_t mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+	createKTX(GL_RGBA8_FORMAT, width, height, mipLevels, ktxData);
+
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	std::vector<unsigned char> nextLevel;
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		appendLevel(level.data(), static_cast<uint32_t>(level.size()), ktxData);
+		if (i + 1 < mipLevels) {
+			const uint32_t nextWidth = std::max(levelWidth >> 1, 1u);
+			const uint32_t nextHeight = std::max(levelHeight >> 1, 1u);
+			downsample(level, levelWidth, levelHeight, nextLevel, nextWidth, nextHeight);
+			std::swap(level, nextLevel);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+	}
+	return true;
+}
+
+// Block compresses an RGBA8 KTX file created by convert into the given GPU format
+bool TextureCache::compress(const std::vector<unsigned char>& ktxData, Format format, std::vector<unsigned char>& compressedData)
+{
+	KTXHeader header;
+	memcpy(&header, ktxData.data(), sizeof(header));
+	if ((header.glInternalFormat != GL_RGBA8_FORMAT) || (format == FORMAT_RGBA8)) {
+		return false;
+	}
+	std::vector<const unsigned char*> levels(header.numberOfMipmapLevels);
+	size_t offset = sizeof(KTXHeader) + header.bytesOfKeyValueData;
+	for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++) {
+		uint32_t imageSize;
+		memcpy(&imageSize, ktxData.data() + offset, sizeof(imageSize));
+		levels[i] = ktxData.data() + offset + sizeof(imageSize);
+		offset += sizeof(imageSize) + imageSize;
+	}
+	compress(levels, header.pixelWidth, header.pixelHeight, format, compressedData);
+	return true;
+}
+
+// Block compresses a tightly packed RGBA8 mip chain into a KTX file
+// For BC and ETC2, images with transparent texels are stored as BC7 or ETC2 RGBA, all others as BC1 or ETC2 RGB at half the size
+void TextureCache::compress(const std::vector<const unsigned char*>& levels, uint32_t width, uint32_t height, Format format, std::vector<unsigned char>& compressedData)
+{
+	assert(format != FORMAT_RGBA8);
+	const bool alpha = BlockCompressor::hasAlpha(levels[0], (size_t)width * height);
+	BlockCompressor::Format blockFormat = BlockCompressor::ASTC_4x4;
+	uint32_t glInternalFormat = GL_COMPRESSED_ASTC_4x4_FORMAT;
+	if (format == FORMAT_BC) {
+		blockFormat = alpha ? BlockCompressor::BC7 : BlockCompressor::BC1;
+		glInternalFormat = alpha ? GL_COMPRESSED_BC7_FORMAT : GL_COMPRESSED_BC1_FORMAT;
+	}
+	else if (format == FORMAT_ETC2) {
+		blockFormat = alpha ? BlockCompressor::ETC2_RGBA : BlockCompressor::ETC2_RGB;
+		glInternalFormat = alpha ? GL_COMPRESSED_ETC2_RGBA_FORMAT : GL_COMPRESSED_ETC2_RGB_FORMAT;
+	}
+	createKTX(glInternalFormat, width, height, static_cast<uint32_t>(levels.size()), compressedData);
+	std::vector<unsigned char> blocks;
+	for (uint32_t i = 0; i < levels.size(); i++) {
+		BlockCompressor::compress(levels[i], std::max(width >> i, 1u), std::max(height >> i, 1u), blockFormat, blocks);
+		appendLevel(blocks.data(), static_cast<uint32_t>(blocks.size()), compressedData);
+	}
+}
+
+// Supercompression is meant for the RGBA8 universal source, which is only read on a cache miss for the GPU format
+bool TextureCache::write(const std::string& filename, const std::vector<unsigned char>& ktxData, bool supercompress)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), error);
+	// Write to a temporary file first so a partially written file is never picked up
+	// The same image may be converted by several loader threads at once, so the temporary file name is unique per thread
+	std::stringstream tempFilename;
+	tempFilename << filename << "." << std::this_thread::get_id() << ".tmp";
+	{
+		std::ofstream stream(tempFilename.str(), std::ios::binary | std::ios::trunc);
+		if (!stream.is_open()) {
+			std::cerr << "Could not write texture cache file " + filename + "\n";
+			return false;
+		}
+		if (supercompress) {
+			int deflatedSize;
+			unsigned char* deflated = stbi_zlib_compress(const_cast<unsigned char*>(ktxData.data()), static_cast<int>(ktxData.size()), &deflatedSize, 8);
+			if (!deflated) {
+				std::cerr << "Could not write texture cache file " + filename + "\n";
+				return false;
+			}
+			stream.write(reinterpret_cast<const char*>(deflated), deflatedSize);
+			free(deflated);
+		}
+		else {
+			stream.write(reinterpret_cast<const char*>(ktxData.data()), ktxData.size());
+		}
+		if (!stream.good()) {
+			std::cerr << "Could not write texture cache file " + filename + "\n";
+			return false;
+		}
+	}
+	std::filesystem::rename(tempFilename.str(), filename, error);
+	if (error) {
+		std::filesystem::remove(tempFilename.str(), error);
+		return false;
+	}
+	return true;
+}
+
+// Starts a KTX file with the header for a single 2D image, mip levels are added with appendLevel
+void TextureCache::createKTX(uint32_t glInternalFormat, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<unsigned char>& ktxData)
+{
+	const bool compressed = (glInternalFormat != GL_RGBA8_FORMAT);
+	KTXHeader header{};
+	memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	header.endianness = KTX_ENDIANNESS;
+	// Compressed formats have no type and format
+	header.glType = compressed ? 0 : GL_UNSIGNED_BYTE_TYPE;
+	header.glTypeSize = 1;
+	header.glFormat = compressed ? 0 : GL_RGBA_FORMAT;
+	header.glInternalFormat = glInternalFormat;
+	header.glBaseInternalFormat = ((glInternalFormat == GL_COMPRESSED_BC1_FORMAT) || (glInternalFormat == GL_COMPRESSED_ETC2_RGB_FORMAT)) ? GL_RGB_FORMAT : GL_RGBA_FORMAT;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = mipLevels;
+	ktxData.resize(sizeof(header));
+	memcpy(ktxData.data(), &header, sizeof(header));
+}
+
+// RGBA8 rows and compressed blocks are always 4 byte aligned, so no row or mip padding is required
+void TextureCache::appendLevel(const unsigned char* data, uint32_t size, std::vector<unsigned char>& ktxData)
+{
+	const unsigned char* sizeBytes = reinterpret_cast<const unsigned char*>(&size);
+	ktxData.insert(ktxData.end(), sizeBytes, sizeBytes + sizeof(size));
+	ktxData.insert(ktxData.end(), data, data + size);
+}
+
+// Bilinear downsampling with texel center alignment, matches a linear filtered vkCmdBlitImage between two mip levels
+// For even dimensions this is a 2x2 box filter
+void TextureCache::downsample(const std::vector<unsigned char>& source, uint32_t sourceWidth, uint32_t sourceHeight, std::vector<unsigned char>& target, uint32_t targetWidth, uint32_t targetHeight)
+{
+	struct Tap {
+		uint32_t first;
+		uint32_t second;
+		float weight;
+	};
+	auto getTaps = [](uint32_t sourceSize, uint32_t targetSize) {
+		std::vector<Tap> taps(targetSize);
+		const float scale = (float)sourceSize / (float)targetSize;
+		for (uint32_t i = 0; i < targetSize; i++) {
+			const float position = std::max(((float)i + 0.5f) * scale - 0.5f, 0.0f);
+			const uint32_t first = std::min(static_cast<uint32_t>(position), sourceSize - 1);
+			taps[i] = { first, std::min(first + 1, sourceSize - 1), position - (float)first };
+		}
+		return taps;
+	};
+	const std::vector<Tap> tapsX = getTaps(sourceWidth, targetWidth);
+	const std::vector<Tap> tapsY = getTaps(sourceHeight, targetHeight);
+
+	// Separable filter, rows are filtered horizontally first
+	std::vector<float> rows((size_t)targetWidth * sourceHeight * 4);
+	for (uint32_t y = 0; y < sourceHeight; y++) {
+		const unsigned char* sourceRow = &source[(size_t)y * sourceWidth * 4];
+		float* row = &rows[(size_t)y * targetWidth * 4];
+		for (uint32_t x = 0; x < targetWidth; x++) {
+			const Tap& tap = tapsX[x];
+			for (uint32_t c = 0; c < 4; c++) {
+				row[x * 4 + c] = (float)sourceRow[tap.first * 4 + c] * (1.0f - tap.weight) + (float)sourceRow[tap.second * 4 + c] * tap.weight;
+			}
+		}
+	}
+	target.resize((size_t)targetWidth * targetHeight * 4);
+	for (uint32_t y = 0; y < targetHeight; y++) {
+		const Tap& tap = tapsY[y];
+		const float* first = &rows[(size_t)tap.first * targetWidth * 4];
+		const float* second = &rows[(size_t)tap.second * targetWidth * 4];
+		unsigned char* targetRow = &target[(size_t)y * targetWidth * 4];
+		for (uint32_t i = 0; i < targetWidth * 4; i++) {
+			const float value = first[i] * (1.0f - tap.weight) + second[i] * tap.weight;
+			targetRow[i] = static_cast<unsigned char>(std::min(value + 0.5f, 255.0f));
+		}
+	}
+}
@@ -0,0 +1,33 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// Converts source images (png, jpg) into KTX files with a pre-generated mip chain that are cached on disk
+// Cache files are named after a hash of the source image data, so an image is only decoded the first time it's encountered
+// Converted images are RGBA8 (VK_FORMAT_R8G8B8A8_UNORM), which serves as the universal source for the GPU formats (BC, ETC2 or ASTC)
+// The universal source is supercompressed with zlib on disk, GPU formats are stored as is so they can be uploaded directly
+class TextureCache
+{
+public:
+	enum Format { FORMAT_RGBA8, FORMAT_BC, FORMAT_ETC2, FORMAT_ASTC };
+	static std::string getDirectory(const std::string& filename);
+	static std::string getFilename(const std::string& directory, const unsigned char* data, size_t size, Format format = FORMAT_RGBA8);
+	static bool load(const std::string& filename, std::vector<unsigned char>& ktxData, uint32_t& width, uint32_t& height);
+	static bool convert(const unsigned char* data, size_t size, std::vector<unsigned char>& ktxData, uint32_t& width, uint32_t& height);
+	static bool compress(const std::vector<unsigned char>& ktxData, Format format, std::vector<unsigned char>& compressedData);
+	static void compress(const std::vector<const unsigned char*>& levels, uint32_t width, uint32_t height, Format format, std::vector<unsigned char>& compressedData);
+	static bool write(const std::string& filename, const std::vector<unsigned char>& ktxData, bool supercompress = false);
+private:
+	static void createKTX(uint32_t glInternalFormat, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<unsigned char>& ktxData);
+	static void appendLevel(const unsigned char* data, uint32_t size, std::vector<unsigned char>& ktxData);
+	static void downsample(const std::vector<unsigned char>& source, uint32_t sourceWidth, uint32_t sourceHeight, std::vector<unsigned char>& target, uint32_t targetWidth, uint32_t targetHeight);
+};
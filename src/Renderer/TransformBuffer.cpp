@@ -0,0 +1,85 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "TransformBuffer.h"
+
+TransformBuffer::TransformBuffer(Device* device, uint32_t maxSlotCount, uint32_t frameCount)
+{
+	this->device = device;
+	this->maxSlotCount = maxSlotCount;
+	this->frameCount = frameCount;
+	const VkDeviceSize alignment = device->properties.limits.minUniformBufferOffsetAlignment;
+	slotStride = sizeof(glm::mat4);
+	if (alignment > 0) {
+		slotStride = (slotStride + alignment - 1) & ~(alignment - 1);
+	}
+	transforms.resize(maxSlotCount, glm::mat4(1.0f));
+	// Host visible buffers are persistently mapped
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, slotStride * maxSlotCount * frameCount, nullptr, MemoryCategory::Uniforms));
+	// The descriptor covers a single matrix, the slot is selected by the dynamic offset
+	buffer.setupDescriptor(sizeof(glm::mat4));
+}
+
+TransformBuffer::~TransformBuffer()
+{
+	buffer.destroy();
+}
+
+// Returns a free slot, slots released with free are reused first
+uint32_t TransformBuffer::allocate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!freeSlots.empty()) {
+		const uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	if (slotCount >= maxSlotCount) {
+		vks::tools::exitFatal("Transform buffer is full (" + std::to_string(maxSlotCount) + " slots)", -1);
+	}
+	return slotCount++;
+}
+
+void TransformBuffer::free(uint32_t slot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	transforms[slot] = glm::mat4(1.0f);
+	freeSlots.push_back(slot);
+}
+
+void TransformBuffer::set(uint32_t slot, const glm::mat4& transform)
+{
+	assert(slot < slotCount);
+	transforms[slot] = transform;
+}
+
+// Dynamic offset of the slot for the frame that's currently being recorded
+uint32_t TransformBuffer::getOffset(uint32_t slot)
+{
+	return static_cast<uint32_t>((frameIndex * maxSlotCount + slot) * slotStride);
+}
+
+uint32_t TransformBuffer::getSlotCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return slotCount - static_cast<uint32_t>(freeSlots.size());
+}
+
+// Advances to the next frame's range and copies all matrices into it, call once the GPU is done with the frame that last used that range
+void TransformBuffer::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frameIndex = (frameIndex + 1) % frameCount;
+	unsigned char* target = static_cast<unsigned char*>(buffer.mapped) + frameIndex * maxSlotCount * slotStride;
+	if (slotStride == sizeof(glm::mat4)) {
+		memcpy(target, transforms.data(), slotCount * sizeof(glm::mat4));
+	}
+	else {
+		for (uint32_t i = 0; i < slotCount; i++) {
+			memcpy(target + i * slotStride, &transforms[i], sizeof(glm::mat4));
+		}
+	}
+}
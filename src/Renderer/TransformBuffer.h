@@ -0,0 +1,45 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Buffer.h"
+
+#include <glm/glm.hpp>
+
+// Single host visible uniform buffer that holds the model matrices of all entities
+// Entities get a slot at creation and update their matrix with set, draws select the slot with a dynamic uniform buffer offset
+// Matrices are kept in host memory and copied to the range of the upcoming frame in beginFrame, so entities can update them at any time
+class TransformBuffer
+{
+private:
+	Device* device;
+	std::mutex mutex;
+	uint32_t maxSlotCount;
+	uint32_t frameCount;
+	uint32_t frameIndex = 0;
+	// Size of a slot, aligned to the minimum dynamic uniform buffer offset alignment
+	VkDeviceSize slotStride;
+	std::vector<glm::mat4> transforms;
+	std::vector<uint32_t> freeSlots;
+	// Slots handed out so far, only these are copied
+	uint32_t slotCount = 0;
+public:
+	Buffer buffer;
+	TransformBuffer(Device* device, uint32_t maxSlotCount, uint32_t frameCount);
+	~TransformBuffer();
+	uint32_t allocate();
+	void free(uint32_t slot);
+	void set(uint32_t slot, const glm::mat4& transform);
+	uint32_t getOffset(uint32_t slot);
+	uint32_t getSlotCount();
+	void beginFrame();
+};
@@ -0,0 +1,343 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "UploadManager.h"
+
+UploadManager::UploadManager(Device* device, VkQueue transferQueue, uint32_t transferQueueFamilyIndex, VkQueue graphicsQueue, uint32_t graphicsQueueFamilyIndex, VkDeviceSize capacity)
+{
+	this->device = device;
+	this->capacity = capacity;
+	transfer.queue = transferQueue;
+	transfer.familyIndex = transferQueueFamilyIndex;
+	transfer.commandPool = device->createCommandPool(transferQueueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	dedicatedTransfer = (transferQueueFamilyIndex != graphicsQueueFamilyIndex);
+	if (dedicatedTransfer) {
+		graphics.queue = graphicsQueue;
+		graphics.familyIndex = graphicsQueueFamilyIndex;
+		graphics.commandPool = device->createCommandPool(graphicsQueueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	}
+	else {
+		graphics = transfer;
+	}
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &arena, capacity, nullptr, MemoryCategory::Staging));
+}
+
+UploadManager::~UploadManager()
+{
+	flush(true);
+	arena.destroy();
+	vkDestroyCommandPool(device->handle, transfer.commandPool, nullptr);
+	if (dedicatedTransfer) {
+		vkDestroyCommandPool(device->handle, graphics.commandPool, nullptr);
+	}
+}
+
+VkCommandBuffer UploadManager::beginCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBuffer commandBuffer;
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device->handle, &cmdBufAllocateInfo, &commandBuffer));
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+	return commandBuffer;
+}
+
+VkCommandBuffer UploadManager::getTransferCommandBuffer()
+{
+	if (current.transferCommandBuffer == VK_NULL_HANDLE) {
+		current.transferCommandBuffer = beginCommandBuffer(transfer.commandPool);
+		if (!dedicatedTransfer) {
+			current.graphicsCommandBuffer = current.transferCommandBuffer;
+		}
+	}
+	return current.transferCommandBuffer;
+}
+
+VkCommandBuffer UploadManager::getGraphicsCommandBuffer()
+{
+	if (!dedicatedTransfer) {
+		return getTransferCommandBuffer();
+	}
+	if (current.graphicsCommandBuffer == VK_NULL_HANDLE) {
+		current.graphicsCommandBuffer = beginCommandBuffer(graphics.commandPool);
+	}
+	return current.graphicsCommandBuffer;
+}
+
+// Copies data into staging memory and returns the offset into the returned staging buffer
+VkDeviceSize UploadManager::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer& stagingBuffer)
+{
+	stats.bytesStaged += size;
+	if (size > capacity) {
+		Buffer dedicated;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &dedicated, size, const_cast<void*>(data), MemoryCategory::Staging));
+		current.dedicatedStagingBuffers.push_back(dedicated);
+		stats.dedicatedStagingBuffers++;
+		stagingBuffer = dedicated.buffer;
+		return 0;
+	}
+	while (true) {
+		if ((allocated == released) && (allocated % capacity != 0)) {
+			// Nothing in use, restart at the beginning of the arena
+			allocated = released = (allocated / capacity + 1) * capacity;
+		}
+		const VkDeviceSize position = allocated % capacity;
+		VkDeviceSize padding = ((position + alignment - 1) / alignment) * alignment - position;
+		if (position + padding + size > capacity) {
+			// Wrap around to the start of the arena
+			padding = capacity - position;
+		}
+		if (padding + size <= capacity - (allocated - released)) {
+			const VkDeviceSize offset = (position + padding) % capacity;
+			allocated += padding + size;
+			memcpy(static_cast<uint8_t*>(arena.mapped) + offset, data, size);
+			stagingBuffer = arena.buffer;
+			return offset;
+		}
+		// Arena is full, make room by finishing older batches
+		if (inFlight.empty()) {
+			submit();
+		}
+		retire(true);
+	}
+}
+
+void UploadManager::submit()
+{
+	if ((current.transferCommandBuffer == VK_NULL_HANDLE) && (current.graphicsCommandBuffer == VK_NULL_HANDLE)) {
+		return;
+	}
+	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+	VK_CHECK_RESULT(vkCreateFence(device->handle, &fenceInfo, nullptr, &current.fence));
+
+	if (dedicatedTransfer && (current.transferCommandBuffer != VK_NULL_HANDLE)) {
+		// Copies are executed on the transfer queue, the graphics part of the batch is submitted by retire once they have finished
+		VK_CHECK_RESULT(vkEndCommandBuffer(current.transferCommandBuffer));
+		VK_CHECK_RESULT(vkCreateFence(device->handle, &fenceInfo, nullptr, &current.transferFence));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &current.transferCommandBuffer;
+		{
+			std::lock_guard<std::mutex> lock(device->queueMutex);
+			VK_CHECK_RESULT(vkQueueSubmit(transfer.queue, 1, &submitInfo, current.transferFence));
+		}
+		stats.submits++;
+	}
+	else if (!inFlight.empty() && !inFlight.back().graphicsSubmitted) {
+		// Earlier batches still wait for their transfers, retire submits this batch behind them to keep the acquires in order
+	}
+	else {
+		submitGraphics(current);
+	}
+
+	current.arenaEnd = allocated;
+	inFlight.push_back(current);
+	current = Batch();
+}
+
+// Records the ownership acquires collected so far into the batch's graphics command buffer
+void UploadManager::recordAcquires(Batch& batch)
+{
+	if (batch.bufferAcquires.empty() && batch.imageAcquires.empty()) {
+		return;
+	}
+	vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, batch.acquireStages, 0, 0, nullptr, static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(), static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+	batch.bufferAcquires.clear();
+	batch.imageAcquires.clear();
+	batch.acquireStages = 0;
+}
+
+// Submits the acquires and graphics commands of a batch, signals the batch's fence
+void UploadManager::submitGraphics(Batch& batch)
+{
+	if (batch.graphicsCommandBuffer == VK_NULL_HANDLE) {
+		batch.graphicsCommandBuffer = beginCommandBuffer(graphics.commandPool);
+	}
+	recordAcquires(batch);
+	// Make all writes of this batch visible to the shaders and vertex input of later submissions on the graphics queue
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	VK_CHECK_RESULT(vkEndCommandBuffer(batch.graphicsCommandBuffer));
+	VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+	{
+		std::lock_guard<std::mutex> lock(device->queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(graphics.queue, 1, &submitInfo, batch.fence));
+	}
+	stats.submits++;
+	batch.graphicsSubmitted = true;
+}
+
+// Submits the graphics part of batches whose transfers have finished, releases staging space of finished batches and runs their completion callbacks
+// If wait is set, blocks until at least the oldest batch has finished
+void UploadManager::retire(bool wait)
+{
+	// Graphics parts are submitted in order, and only after the host has seen the transfer fence, so frames never wait on an upload
+	for (auto& batch : inFlight) {
+		if (batch.graphicsSubmitted) {
+			continue;
+		}
+		// Batches without transfer commands only had to wait for the batches in front of them
+		if (batch.transferFence != VK_NULL_HANDLE) {
+			if (wait && (&batch == &inFlight.front())) {
+				VK_CHECK_RESULT(vkWaitForFences(device->handle, 1, &batch.transferFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				stats.waits++;
+			}
+			else if (vkGetFenceStatus(device->handle, batch.transferFence) != VK_SUCCESS) {
+				break;
+			}
+		}
+		submitGraphics(batch);
+		stats.deferredAcquires++;
+	}
+
+	bool waitForNext = wait;
+	while (!inFlight.empty()) {
+		Batch& batch = inFlight.front();
+		if (!batch.graphicsSubmitted) {
+			break;
+		}
+		if (waitForNext) {
+			VK_CHECK_RESULT(vkWaitForFences(device->handle, 1, &batch.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			stats.waits++;
+			waitForNext = false;
+		}
+		else if (vkGetFenceStatus(device->handle, batch.fence) != VK_SUCCESS) {
+			break;
+		}
+		released = batch.arenaEnd;
+		for (auto& buffer : batch.dedicatedStagingBuffers) {
+			buffer.destroy();
+		}
+		for (auto& callback : batch.callbacks) {
+			callback();
+		}
+		if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(device->handle, transfer.commandPool, 1, &batch.transferCommandBuffer);
+		}
+		if (dedicatedTransfer) {
+			vkFreeCommandBuffers(device->handle, graphics.commandPool, 1, &batch.graphicsCommandBuffer);
+			if (batch.transferFence != VK_NULL_HANDLE) {
+				vkDestroyFence(device->handle, batch.transferFence, nullptr);
+			}
+		}
+		vkDestroyFence(device->handle, batch.fence, nullptr);
+		inFlight.pop_front();
+	}
+}
+
+// Records a copy of the given data into a buffer
+void UploadManager::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkBuffer stagingBuffer;
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = stage(data, size, 16, stagingBuffer);
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(getTransferCommandBuffer(), stagingBuffer, dstBuffer, 1, &copyRegion);
+	if (dedicatedTransfer) {
+		// Queue family ownership transfer (release on the transfer queue, acquire on the graphics queue)
+		VkBufferMemoryBarrier bufferBarrier{};
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.srcQueueFamilyIndex = transfer.familyIndex;
+		bufferBarrier.dstQueueFamilyIndex = graphics.familyIndex;
+		bufferBarrier.buffer = dstBuffer;
+		bufferBarrier.offset = dstOffset;
+		bufferBarrier.size = size;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(getTransferCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		// Buffers are read as vertex/index data or by shaders
+		bufferBarrier.srcAccessMask = 0;
+		bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		current.bufferAcquires.push_back(bufferBarrier);
+		current.acquireStages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+}
+
+// Records the copy of the given data into an image (region buffer offsets are relative to data)
+// The subresource range is transitioned from undefined to newLayout
+void UploadManager::uploadImage(VkImage image, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, VkImageSubresourceRange subresourceRange, VkImageLayout newLayout)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkBuffer stagingBuffer;
+	// Offset needs to be a multiple of the texel (or compressed block) size
+	const VkDeviceSize offset = stage(data, size, 16, stagingBuffer);
+	for (auto& region : regions) {
+		region.bufferOffset += offset;
+	}
+	VkCommandBuffer transferCommandBuffer = getTransferCommandBuffer();
+	vks::tools::setImageLayout(transferCommandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	vkCmdCopyBufferToImage(transferCommandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	if (dedicatedTransfer) {
+		// Queue family ownership transfer including the transition to the final layout
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.srcQueueFamilyIndex = transfer.familyIndex;
+		imageBarrier.dstQueueFamilyIndex = graphics.familyIndex;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		// Images are either sampled in fragment shaders or the source of mip map blits
+		const bool blitSource = (newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = blitSource ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+		current.imageAcquires.push_back(imageBarrier);
+		current.acquireStages |= blitSource ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+	else if (newLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+		vks::tools::setImageLayout(transferCommandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newLayout, subresourceRange);
+	}
+}
+
+// Records additional commands into the current batch (e.g. mip map generation)
+// These are executed on the graphics queue after all uploads recorded so far
+void UploadManager::record(std::function<void(VkCommandBuffer)> commands)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	getGraphicsCommandBuffer();
+	recordAcquires(current);
+	commands(current.graphicsCommandBuffer);
+}
+
+// Callback is run on the thread calling update or flush once all uploads recorded so far have finished
+// Callbacks must not call back into the upload manager
+void UploadManager::onComplete(std::function<void()> callback)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	getGraphicsCommandBuffer();
+	current.callbacks.push_back(callback);
+}
+
+// Submits all recorded uploads, if wait is set this also blocks until all uploads have finished
+void UploadManager::flush(bool wait)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	submit();
+	if (wait) {
+		while (!inFlight.empty()) {
+			retire(true);
+		}
+	}
+	else {
+		retire(false);
+	}
+}
+
+// Non-blocking, submits pending uploads and retires finished batches
+// Called once per frame, so uploads recorded by several resources during a frame end up in a single submit
+void UploadManager::update()
+{
+	flush(false);
+}
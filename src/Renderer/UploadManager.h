@@ -0,0 +1,87 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.h"
+#include "VulkanTools.h"
+#include "Device.h"
+#include "Buffer.h"
+
+// Collects uploads from many resources into a few command buffers
+// Data is copied into a ring buffer staging arena, the space is reclaimed once the fence of the batch using it has been signaled
+// If the device has a dedicated transfer queue, copies are executed on that queue and ownership of the resources is transferred
+// to the graphics queue. The acquire is only submitted once the transfer fence has signaled, so the graphics queue never waits on a transfer
+// Uploads are acquired in order on the graphics queue, so resources can be used by any submission on that queue after the batch's completion callbacks have run
+class UploadManager
+{
+private:
+	struct Batch {
+		// Copies and ownership releases, same as graphicsCommandBuffer if there is no dedicated transfer queue
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		// Ownership acquires and commands that require a graphics queue (e.g. blits)
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+		// Acquire barriers are collected and recorded with a single barrier command before the batch's graphics commands
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		VkPipelineStageFlags acquireStages = 0;
+		// Signaled once the copies on the dedicated transfer queue have finished
+		VkFence transferFence = VK_NULL_HANDLE;
+		// Signaled once the whole batch has finished
+		VkFence fence = VK_NULL_HANDLE;
+		bool graphicsSubmitted = false;
+		// Arena position up to which staging space can be released once this batch has finished
+		VkDeviceSize arenaEnd = 0;
+		// Uploads larger than the arena get their own staging buffer
+		std::vector<Buffer> dedicatedStagingBuffers;
+		std::vector<std::function<void()>> callbacks;
+	};
+	Device* device;
+	struct QueueInfo {
+		VkQueue queue;
+		uint32_t familyIndex;
+		VkCommandPool commandPool;
+	} transfer, graphics;
+	bool dedicatedTransfer;
+	std::mutex mutex;
+	Buffer arena;
+	VkDeviceSize capacity;
+	// Monotonic counters, the current ring position is allocated % capacity
+	VkDeviceSize allocated = 0;
+	VkDeviceSize released = 0;
+	Batch current;
+	std::deque<Batch> inFlight;
+	VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool);
+	VkCommandBuffer getTransferCommandBuffer();
+	VkCommandBuffer getGraphicsCommandBuffer();
+	void recordAcquires(Batch& batch);
+	void submitGraphics(Batch& batch);
+	VkDeviceSize stage(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer& stagingBuffer);
+	void submit();
+	void retire(bool wait);
+public:
+	struct Stats {
+		uint32_t submits = 0;
+		uint32_t waits = 0;
+		// Graphics submits of batches held back until their transfer had finished
+		uint32_t deferredAcquires = 0;
+		uint32_t dedicatedStagingBuffers = 0;
+		VkDeviceSize bytesStaged = 0;
+	} stats;
+	UploadManager(Device* device, VkQueue transferQueue, uint32_t transferQueueFamilyIndex, VkQueue graphicsQueue, uint32_t graphicsQueueFamilyIndex, VkDeviceSize capacity = 64 * 1024 * 1024);
+	~UploadManager();
+	void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+	void uploadImage(VkImage image, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, VkImageSubresourceRange subresourceRange, VkImageLayout newLayout);
+	void record(std::function<void(VkCommandBuffer)> commands);
+	void onComplete(std::function<void()> callback);
+	void flush(bool wait = false);
+	void update();
+};
@@ -67,6 +67,12 @@ void VulkanRenderer::waitSync()
 {
 	VK_CHECK_RESULT(vkWaitForFences(device->handle, 1, &cbWaitFence, VK_TRUE, UINT64_MAX));
 	VK_CHECK_RESULT(vkResetFences(device->handle, 1, &cbWaitFence));
+	// The previous frame has finished
+	descriptorAllocator->beginFrame();
+	transformBuffer->beginFrame();
+	instanceBuffer->beginFrame();
+	assetManager->jointBuffer->beginFrame();
+	device->memoryTracker->beginFrame();
 }
 
 void VulkanRenderer::submitFrame()
@@ -90,9 +96,15 @@ void VulkanRenderer::submitFrame()
 	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer->handle;
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, cbWaitFence));
+	// Submit uploads recorded since the last frame, so they're executed before this frame's commands
+	device->uploadManager->update();
 
-	result = swapchain->queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	// Asset uploads may submit to the same queue from other threads
+	{
+		std::lock_guard<std::mutex> lock(device->queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, cbWaitFence));
+		result = swapchain->queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	}
 	if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			// Swap chain is no longer compatible with the surface and needs to be recreated
@@ -197,13 +209,25 @@ VulkanRenderer::VulkanRenderer()
 
 	device = new Device(physicalDevice, instance);
 	device->enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// Textures are block compressed on load to the first supported of BC, ETC2 and ASTC, uncompressed RGBA8 is used as the fallback
+	device->enabledFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC;
+	device->enabledFeatures.textureCompressionETC2 = deviceFeatures.textureCompressionETC2;
+	device->enabledFeatures.textureCompressionASTC_LDR = deviceFeatures.textureCompressionASTC_LDR;
 	device->enabledFeatures.independentBlend = VK_TRUE;
-	VkResult res = device->create();
+	VkResult res = device->create(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 	}
 
 	vkGetDeviceQueue(device->handle, device->queueFamilyIndices.graphics, 0, &queue);
+	// Resource uploads are done on a dedicated transfer queue if available
+	VkQueue transferQueue = queue;
+	if (device->queueFamilyIndices.transfer != device->queueFamilyIndices.graphics) {
+		vkGetDeviceQueue(device->handle, device->queueFamilyIndices.transfer, 0, &transferQueue);
+		std::clog << "Using dedicated transfer queue (family " << device->queueFamilyIndices.transfer << ") for uploads\n";
+	}
+	device->uploadManager = new UploadManager(device, transferQueue, device->queueFamilyIndices.transfer, queue, device->queueFamilyIndices.graphics);
+	device->samplerCache = new SamplerCache(device);
 
 	assetManager->setDevice(device);
 	assetManager->setTransferQueue(queue);
@@ -234,16 +258,16 @@ VulkanRenderer::VulkanRenderer()
 
 	setupLayouts();
 	loadPipelines();
-	setupDescriptorPool();
+	setupDescriptorAllocator();
 
 	// Deferred composition
-	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &deferredComposition.lightsBuffer, sizeof(deferredUniformData)));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &deferredComposition.lightsBuffer, sizeof(deferredUniformData), nullptr, MemoryCategory::Uniforms));
 	deferredUniformData.screenRes = glm::vec2(width, height);
 	deferredUniformData.renderRes = glm::vec2(renderWidth, renderHeight);
 	deferredUniformData.scanlines = settings.crtshader;
 
 	deferredComposition.descriptorSet = new DescriptorSet(device->handle);
-	deferredComposition.descriptorSet->setPool(descriptorPool);
+	deferredComposition.descriptorSet->setAllocator(descriptorAllocator);
 	deferredComposition.descriptorSet->addLayout(getDescriptorSetLayout("deferred_composition"));
 	deferredComposition.descriptorSet->addDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &offscreenPass.position.descriptor);
 	deferredComposition.descriptorSet->addDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &offscreenPass.normal.descriptor);
@@ -256,10 +280,23 @@ VulkanRenderer::VulkanRenderer()
 	// Camera
 	camera.prepareGPUResources(device);
 	descriptorSets.camera = new DescriptorSet(device->handle);
-	descriptorSets.camera->setPool(descriptorPool);
-	descriptorSets.camera->addLayout(getDescriptorSetLayout("single_ubo"));
+	descriptorSets.camera->setAllocator(descriptorAllocator);
+	descriptorSets.camera->addLayout(getDescriptorSetLayout("scene"));
 	descriptorSets.camera->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &camera.ubo.descriptor);
+	descriptorSets.camera->addDescriptor(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &assetManager->materialBuffer->buffer.descriptor);
+	descriptorSets.camera->addDescriptor(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &assetManager->jointBuffer->buffer.descriptor);
 	descriptorSets.camera->create();
+
+	// Entity transforms
+	// Only one frame is in flight (see waitSync), so the transforms only need a single range
+	transformBuffer = new TransformBuffer(device, 256, 1);
+	// Per-instance data for instanced draws, only one frame is in flight
+	instanceBuffer = new InstanceBuffer(device, 256 * 1024, 1);
+	descriptorSets.transforms = new DescriptorSet(device->handle);
+	descriptorSets.transforms->setAllocator(descriptorAllocator);
+	descriptorSets.transforms->addLayout(getDescriptorSetLayout("transform"));
+	descriptorSets.transforms->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &transformBuffer->buffer.descriptor);
+	descriptorSets.transforms->create();
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -271,6 +308,7 @@ VulkanRenderer::~VulkanRenderer()
 		vkDestroyFramebuffer(device->handle, frameBuffers[i], nullptr);
 	}
 
+	delete device->uploadManager;
 	delete swapchain;
 	delete depthStencilImage;
 	delete depthStencilImageView;
@@ -281,7 +319,14 @@ VulkanRenderer::~VulkanRenderer()
 	vkDestroySemaphore(device->handle, semaphores.renderComplete, nullptr);
 	vkDestroyFence(device->handle, cbWaitFence, nullptr);
 
-	vkDestroySampler(device->handle, offscreenPass.sampler, nullptr);
+	device->samplerCache->release(offscreenPass.sampler);
+	delete deferredComposition.descriptorSet;
+	delete descriptorSets.camera;
+	delete descriptorSets.transforms;
+	delete transformBuffer;
+	delete instanceBuffer;
+	delete descriptorAllocator;
+	delete device->samplerCache;
 
 	if (settings.validation)
 	{
@@ -307,6 +352,7 @@ void VulkanRenderer::setupDepthStencil()
 	depthStencilImage->setExtent({ width, height, 1 });
 	depthStencilImage->setTiling(VK_IMAGE_TILING_OPTIMAL);
 	depthStencilImage->setUsage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	depthStencilImage->setMemoryCategory(MemoryCategory::Attachments);
 	depthStencilImage->create();
 
 	depthStencilImageView = new ImageView(device);
@@ -372,6 +418,7 @@ void VulkanRenderer::createFrameBufferImage(FrameBufferAttachment& target, Frame
 	target.image->setExtent({ (uint32_t)offscreenPass.width, (uint32_t)offscreenPass.height, 1 });
 	target.image->setTiling(VK_IMAGE_TILING_OPTIMAL);
 	target.image->setUsage(usageFlags);
+	target.image->setMemoryCategory(MemoryCategory::Attachments);
 	target.image->create();
 
 	target.view = new ImageView(device);
@@ -395,6 +442,7 @@ void VulkanRenderer::setupRenderPass()
 	const VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
 	RenderPass* renderPass = addRenderPass("deferred_composition");
+	deferredComposition.renderPass = renderPass;
 	renderPass->setDimensions(width, height);
 	renderPass->addSubpassDescription({
 		0,
@@ -604,7 +652,7 @@ void VulkanRenderer::setupOffscreenRenderPass()
 	samplerInfo.minLod = 0.0f;
 	samplerInfo.maxLod = 1.0f;
 	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	VK_CHECK_RESULT(vkCreateSampler(device->handle, &samplerInfo, nullptr, &offscreenPass.sampler));
+	offscreenPass.sampler = device->samplerCache->acquire(samplerInfo);
 
 	/* Framebuffer images */
 	createFrameBufferImage(offscreenPass.position, FramebufferType::Color, VK_FORMAT_R16G16B16A16_SFLOAT, "G-Buffer positions");
@@ -643,6 +691,23 @@ void VulkanRenderer::setupLayouts()
 	descriptorSetLayout->addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
 	descriptorSetLayout->create();
 
+	// Single storage buffer binding point, for per-instance arrays that don't fit into a UBO
+	descriptorSetLayout = addDescriptorSetLayout("single_ssbo");
+	descriptorSetLayout->addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+	descriptorSetLayout->create();
+
+	// Entity model matrix, selected with a dynamic offset into the transform buffer
+	descriptorSetLayout = addDescriptorSetLayout("transform");
+	descriptorSetLayout->addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT);
+	descriptorSetLayout->create();
+
+	// Camera UBO, material and joint storage buffers, first set of all scene pipelines
+	descriptorSetLayout = addDescriptorSetLayout("scene");
+	descriptorSetLayout->addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+	descriptorSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	descriptorSetLayout->addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+	descriptorSetLayout->create();
+
 	// Single image binding point
 	descriptorSetLayout = addDescriptorSetLayout("single_image");
 	descriptorSetLayout->addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -659,21 +724,31 @@ void VulkanRenderer::setupLayouts()
 
 	PipelineLayout* pipelineLayout;
 	pipelineLayout = addPipelineLayout("split_ubo");
-	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
-	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("scene"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("transform"));
 	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockMaterial), 0, VK_SHADER_STAGE_FRAGMENT_BIT);
+	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockVertex), vkglTF::PUSH_CONSTANT_VERTEX_OFFSET, VK_SHADER_STAGE_VERTEX_BIT);
 	pipelineLayout->create();
 
 	pipelineLayout = addPipelineLayout("split_ubo_single_image");
-	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
-	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("scene"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("transform"));
 	pipelineLayout->addLayout(getDescriptorSetLayout("single_image"));
 	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockMaterial), 0, VK_SHADER_STAGE_FRAGMENT_BIT);
+	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockVertex), vkglTF::PUSH_CONSTANT_VERTEX_OFFSET, VK_SHADER_STAGE_VERTEX_BIT);
+	pipelineLayout->create();
+
+	// Projectile positions are stored in a single storage buffer instead of per-entity transforms
+	pipelineLayout = addPipelineLayout("projectiles");
+	pipelineLayout->addLayout(getDescriptorSetLayout("scene"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("single_ssbo"));
+	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockMaterial), 0, VK_SHADER_STAGE_FRAGMENT_BIT);
+	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockVertex), vkglTF::PUSH_CONSTANT_VERTEX_OFFSET, VK_SHADER_STAGE_VERTEX_BIT);
 	pipelineLayout->create();
 
 	// glTF PBR rendering (one ubo for camera, one for model, and one for pbr texture bindings)
 	pipelineLayout = addPipelineLayout("gltf_pbr");
-	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
+	pipelineLayout->addLayout(getDescriptorSetLayout("scene"));
 	pipelineLayout->addLayout(getDescriptorSetLayout("single_ubo"));
 	pipelineLayout->addLayout(getDescriptorSetLayout("gltf_pbr_images"));
 	pipelineLayout->addPushConstantRange(sizeof(vkglTF::PushConstBlockMaterial), 0, VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -703,31 +778,123 @@ void VulkanRenderer::setupLayouts()
 	pipelineLayout = addPipelineLayout("deferred_composition");
 	pipelineLayout->addLayout(getDescriptorSetLayout("deferred_composition"));
 	pipelineLayout->create();
+	deferredComposition.pipelineLayout = pipelineLayout;
 }
 
 void VulkanRenderer::loadPipelines()
 {
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	std::vector<PipelineDefinition> definitions;
 	for (const auto& file : std::filesystem::directory_iterator(assetManager->assetPath + "pipelines")) {
 		const std::string ext = file.path().extension().string();
 		if (ext == ".json") {
-			loadPipelineFromFile(file.path().string());
+			PipelineDefinition definition{};
+			definition.filename = file.path().string();
+			definitions.push_back(definition);
 		}
 	}
+	if (definitions.empty()) {
+		return;
+	}
+
+	// Parse definitions and load shaders on worker threads
+	// The definitions vector must not be resized from here on, as the workers and the create infos reference its elements
+	std::atomic<size_t> nextDefinition{ 0 };
+	const size_t workerCount = std::min(definitions.size(), static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)));
+	std::vector<std::future<void>> workers;
+	for (size_t i = 0; i < workerCount; i++) {
+		workers.push_back(std::async(std::launch::async, [&]() {
+			size_t index;
+			while ((index = nextDefinition++) < definitions.size()) {
+				loadPipelineDefinition(definitions[index]);
+			}
+		}));
+	}
+	for (auto& worker : workers) {
+		// Rethrows exceptions from the workers (e.g. malformed JSON)
+		worker.get();
+	}
+
+	// Create all pipelines with a single call sharing the pipeline cache
+	std::vector<PipelineDefinition*> validDefinitions;
+	std::vector<VkGraphicsPipelineCreateInfo> pipelineCIs;
+	for (auto& definition : definitions) {
+		if (!definition.pipeline) {
+			continue;
+		}
+		// Pipelines of optional features are skipped if the device doesn't support them
+		if (pipelineLayouts.count(definition.layout) == 0) {
+			if (!definition.optional) {
+				vks::tools::exitFatal("Pipeline \"" + definition.name + "\" uses unknown layout \"" + definition.layout + "\"", -1);
+			}
+			std::clog << "Skipping optional pipeline \"" << definition.name << "\", layout \"" << definition.layout << "\" is not available\n";
+			delete definition.pipeline;
+			definition.pipeline = nullptr;
+			continue;
+		}
+		definition.colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(definition.blendAttachmentStates.size()), definition.blendAttachmentStates.data());
+		definition.dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(definition.dynamicStateEnables);
+		definition.vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		definition.vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(definition.vertexInputBindings.size());
+		definition.vertexInputState.pVertexBindingDescriptions = definition.vertexInputBindings.data();
+		definition.vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(definition.vertexInputAttributes.size());
+		definition.vertexInputState.pVertexAttributeDescriptions = definition.vertexInputAttributes.data();
+
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCI.pVertexInputState = &definition.vertexInputState;
+		pipelineCI.pInputAssemblyState = &definition.inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &definition.rasterizationStateCI;
+		pipelineCI.pColorBlendState = &definition.colorBlendStateCI;
+		pipelineCI.pMultisampleState = &definition.multisampleStateCI;
+		pipelineCI.pViewportState = &definition.viewportStateCI;
+		pipelineCI.pDepthStencilState = &definition.depthStencilStateCI;
+		pipelineCI.pDynamicState = &definition.dynamicStateCI;
+
+		Pipeline* pipeline = definition.pipeline;
+		pipeline->setCache(pipelineCache);
+		pipeline->setLayout(getPipelineLayout(definition.layout));
+		pipeline->setRenderPass(getRenderPass(definition.renderPass));
+		pipeline->setCreateInfo(pipelineCI);
+		pipelineCIs.push_back(pipeline->getCreateInfo());
+		validDefinitions.push_back(&definition);
+	}
+
+	std::vector<VkPipeline> handles(pipelineCIs.size(), VK_NULL_HANDLE);
+	if (!pipelineCIs.empty()) {
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->handle, pipelineCache, static_cast<uint32_t>(pipelineCIs.size()), pipelineCIs.data(), nullptr, handles.data()));
+	}
+	for (size_t i = 0; i < validDefinitions.size(); i++) {
+		validDefinitions[i]->pipeline->setHandle(handles[i]);
+		addPipeline(validDefinitions[i]->name, validDefinitions[i]->pipeline);
+	}
+
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	std::clog << "Created " << handles.size() << " pipelines using " << workerCount << " worker threads in " << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
+	std::clog << "Shader module cache: " << assetManager->shaderModuleCacheStats.hits << " hits, " << assetManager->shaderModuleCacheStats.misses << " misses, " << assetManager->shaderModuleCacheStats.bytesRead << " bytes read" << std::endl;
 }
 
-void VulkanRenderer::setupDescriptorPool()
+void VulkanRenderer::setupDescriptorAllocator()
 {
-	// @todo: proper sizes
-	descriptorPool = new DescriptorPool(device->handle);
-	descriptorPool->setMaxSets(1024);
-	descriptorPool->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1024);
-	descriptorPool->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1024);
-	descriptorPool->create();
+	descriptorAllocator = new DescriptorAllocator(device->handle);
+	// Sizes of a single pool, more pools are chained if required
+	descriptorAllocator->setMaxSets(256);
+	descriptorAllocator->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 256);
+	descriptorAllocator->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1024);
+	descriptorAllocator->addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 64);
+	descriptorAllocator->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 16);
+	// glTF material sets also come from this allocator
+	vkglTF::descriptorAllocator = descriptorAllocator;
+	vkglTF::materialDescriptorSetLayout = getDescriptorSetLayout("gltf_pbr_images")->handle;
 }
 
 void VulkanRenderer::windowResize()
 {
-	vkDeviceWaitIdle(device->handle);
+	{
+		std::lock_guard<std::mutex> lock(device->queueMutex);
+		vkDeviceWaitIdle(device->handle);
+	}
 	width = destWidth;
 	height = destHeight;
 	swapchain->create(&width, &height, settings.vsync);
@@ -756,7 +923,7 @@ PipelineLayout* VulkanRenderer::addPipelineLayout(std::string name)
 	return pipelineLayout;
 }
 
-PipelineLayout* VulkanRenderer::getPipelineLayout(std::string name)
+PipelineLayout* VulkanRenderer::getPipelineLayout(const std::string& name)
 {
 	assert(pipelineLayouts.count(name) > 0);
 	return pipelineLayouts[name];
@@ -765,10 +932,15 @@ PipelineLayout* VulkanRenderer::getPipelineLayout(std::string name)
 Pipeline* VulkanRenderer::addPipeline(std::string name)
 {
 	Pipeline* pipeline = new Pipeline(device->handle);
-	pipelines[name] = pipeline;
+	addPipeline(name, pipeline);
 	return pipeline;
 }
 
+void VulkanRenderer::addPipeline(std::string name, Pipeline* pipeline)
+{
+	pipelines[name] = pipeline;
+}
+
 VkBlendOp blendOpEnum(const std::string &value)
 {
 	if (value == "VK_BLEND_OP_ADD") {
@@ -826,57 +998,58 @@ VkFormat formatEnum(const std::string& value)
 	if (value == "VK_FORMAT_R32G32B32A32_SFLOAT") {
 		return VK_FORMAT_R32G32B32A32_SFLOAT;
 	}
+	if (value == "VK_FORMAT_R16G16_SFLOAT") {
+		return VK_FORMAT_R16G16_SFLOAT;
+	}
+	if (value == "VK_FORMAT_R16G16_SNORM") {
+		return VK_FORMAT_R16G16_SNORM;
+	}
+	if (value == "VK_FORMAT_R16G16B16A16_SNORM") {
+		return VK_FORMAT_R16G16B16A16_SNORM;
+	}
 }
 
-Pipeline* VulkanRenderer::loadPipelineFromFile(std::string filename)
+// Reads a pipeline description from a JSON file and loads the referenced shaders
+// Called from worker threads, so this must not touch any of the renderer's registries
+bool VulkanRenderer::loadPipelineDefinition(PipelineDefinition& definition)
 {
-	std::clog << "Loading pipeline from \"" << filename << "\"" << std::endl;
-	std::ifstream is(filename);
+	std::ifstream is(definition.filename);
 	if (!is.is_open())
 	{
-		std::cerr << "Error: Could not open pipeline definition file \"" << filename << "\"" << std::endl;
-		return nullptr;
+		std::cerr << "Error: Could not open pipeline definition file \"" + definition.filename + "\"\n";
+		return false;
 	}
 	nlohmann::json json;
 	is >> json;
 	is.close();
-	Pipeline* pipeline = addPipeline(json["name"]);
-	pipeline->setCache(pipelineCache);
-	pipeline->setLayout(getPipelineLayout(json["layout"]));
-	pipeline->setRenderPass(getRenderPass(json["renderpass"]));
+	definition.name = json["name"];
+	definition.layout = json["layout"];
+	definition.renderPass = json["renderpass"];
+	definition.optional = (json.count("optional") > 0) && json["optional"].get<bool>();
+	Pipeline* pipeline = new Pipeline(device->handle);
 	for (auto& shader : json["shaders"]) {
 		std::string shaderName = shader;
 		pipeline->addShader("shaders/" + shaderName);
 	}
 	// Pipeline creation info members can be set explicitly
 	// If not present, default values are applied
-	const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-	const VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
-	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI;
-	const VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
-	const VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
-	const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-	const VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-	std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates;
-	VkPipelineColorBlendStateCreateInfo colorBlendStateCI;
-	std::vector<VkVertexInputBindingDescription> vertexInputBindings;
-	std::vector<VkVertexInputAttributeDescription> vertexInputAttributes;
-	VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
-
-	VkGraphicsPipelineCreateInfo pipelineCI{};
-	pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	definition.inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+	definition.rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
+	definition.viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+	definition.multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+	definition.dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
 	if (json.count("depthStencilState") > 0) {
-		depthStencilStateCI = {};
-		depthStencilStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencilStateCI.front.compareOp = VK_COMPARE_OP_ALWAYS;
-		depthStencilStateCI.back.compareOp = VK_COMPARE_OP_ALWAYS;
-		depthStencilStateCI.depthTestEnable = json["depthStencilState"]["depthTest"];
-		depthStencilStateCI.depthWriteEnable = json["depthStencilState"]["depthWrite"];
-		depthStencilStateCI.depthCompareOp = compareOpEnum(json["depthStencilState"]["compareOp"]);
+		definition.depthStencilStateCI = {};
+		definition.depthStencilStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		definition.depthStencilStateCI.front.compareOp = VK_COMPARE_OP_ALWAYS;
+		definition.depthStencilStateCI.back.compareOp = VK_COMPARE_OP_ALWAYS;
+		definition.depthStencilStateCI.depthTestEnable = json["depthStencilState"]["depthTest"];
+		definition.depthStencilStateCI.depthWriteEnable = json["depthStencilState"]["depthWrite"];
+		definition.depthStencilStateCI.depthCompareOp = compareOpEnum(json["depthStencilState"]["compareOp"]);
 	}
 	else {
-		depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		definition.depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
 	}
 
 	if (json.count("colorBlendState") > 0) {
@@ -893,13 +1066,13 @@ Pipeline* VulkanRenderer::loadPipelineFromFile(std::string filename)
 					pipelineColorBlendAttachmentState.dstAlphaBlendFactor = blendFactorEnum(attachment["alpha"]["dstFactor"]);
 					pipelineColorBlendAttachmentState.alphaBlendOp = blendOpEnum(attachment["alpha"]["op"]);
 				}
-				blendAttachmentStates.push_back(pipelineColorBlendAttachmentState);
+				definition.blendAttachmentStates.push_back(pipelineColorBlendAttachmentState);
 			}
 		}
 	}
 	else {
 		// Default setup is based on G-Buffer passes
-		blendAttachmentStates = {
+		definition.blendAttachmentStates = {
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
@@ -907,7 +1080,19 @@ Pipeline* VulkanRenderer::loadPipelineFromFile(std::string filename)
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
 	}
-	colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(blendAttachmentStates.size()), blendAttachmentStates.data());
+
+	// Vertex layout of the models drawn with this pipeline, models with a different layout are rejected (see checkModelVertexFormat)
+	const std::string vertexFormat = (json.count("vertexFormat") > 0) ? json["vertexFormat"].get<std::string>() : "full";
+	if (vertexFormat == "compact") {
+		pipeline->setModelVertexFormat(vkglTF::Model::VERTEX_FORMAT_COMPACT);
+	}
+	else if (vertexFormat == "full") {
+		pipeline->setModelVertexFormat(vkglTF::Model::VERTEX_FORMAT_FULL);
+	}
+	else {
+		std::cerr << "Error: Unknown vertex format \"" + vertexFormat + "\" in pipeline definition file \"" + definition.filename + "\"\n";
+		return false;
+	}
 
 	if (json.count("vertexInputState") > 0) {
 		if (json["vertexInputState"].count("vertexBindingDescriptions") > 0) {
@@ -916,7 +1101,7 @@ Pipeline* VulkanRenderer::loadPipelineFromFile(std::string filename)
 				bindingDescription.binding = description["binding"];
 				bindingDescription.stride = description["stride"];
 				bindingDescription.inputRate = vertexInputRateEnum(description["inputRate"]);
-				vertexInputBindings.push_back(bindingDescription);
+				definition.vertexInputBindings.push_back(bindingDescription);
 			}
 		}
 		if (json["vertexInputState"].count("vertexAttributeDescriptions") > 0) {
@@ -926,47 +1111,59 @@ Pipeline* VulkanRenderer::loadPipelineFromFile(std::string filename)
 				attributeDescription.location = description["location"];
 				attributeDescription.offset = description["offset"];
 				attributeDescription.format = formatEnum(description["format"]);
-				vertexInputAttributes.push_back(attributeDescription);
+				definition.vertexInputAttributes.push_back(attributeDescription);
 			}
 		}
 	}
+	else if (vertexFormat == "compact") {
+		// Compact vertex format used by static meshes
+		definition.vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(vkglTF::Model::CompactVertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		definition.vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(vkglTF::Model::CompactVertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R16G16_SNORM, offsetof(vkglTF::Model::CompactVertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R16G16_SFLOAT, offsetof(vkglTF::Model::CompactVertex, uv)),
+		};
+	}
 	else {
 		// Default setup is based on glTF model vertex input
-		vertexInputBindings = {
+		definition.vertexInputBindings = {
 			vks::initializers::vertexInputBindingDescription(0, sizeof(vkglTF::Model::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
 		};
-		vertexInputAttributes = {
+		definition.vertexInputAttributes = {
 			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Model::Vertex, pos)),
 			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Model::Vertex, normal)),
 			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(vkglTF::Model::Vertex, uv0)),
+			// Skinning attributes, only read by shaders of skinned pipelines
+			vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vkglTF::Model::Vertex, joint0)),
+			vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vkglTF::Model::Vertex, weight0)),
 		};
 	}
-	vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size());
-	vertexInputState.pVertexBindingDescriptions = vertexInputBindings.data();
-	vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
-	vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
-	pipelineCI.pVertexInputState = &vertexInputState;
-	pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
-	pipelineCI.pRasterizationState = &rasterizationStateCI;
-	pipelineCI.pColorBlendState = &colorBlendStateCI;
-	pipelineCI.pMultisampleState = &multisampleStateCI;
-	pipelineCI.pViewportState = &viewportStateCI;
-	pipelineCI.pDepthStencilState = &depthStencilStateCI;
-	pipelineCI.pDynamicState = &dynamicStateCI;
-
-	pipeline->setCreateInfo(pipelineCI);
-	pipeline->create();
-
-	return pipeline;
+	definition.pipeline = pipeline;
+	return true;
 }
 
-Pipeline* VulkanRenderer::getPipeline(std::string name)
+Pipeline* VulkanRenderer::getPipeline(const std::string& name)
 {
 	assert(pipelines.count(name) > 0);
 	return pipelines[name];
 }
 
+// Fails if a model is going to be drawn with a pipeline that expects a different vertex layout
+// Models fall back to the full layout (e.g. skinned meshes), so this needs to be checked once the model has been loaded
+void VulkanRenderer::checkModelVertexFormat(const std::string& pipelineName, const std::string& modelName)
+{
+	vkglTF::Model* model = assetManager->getModel(modelName);
+	assert(model);
+	Pipeline* pipeline = getPipeline(pipelineName);
+	if (model->vertexFormat != pipeline->getModelVertexFormat()) {
+		auto formatName = [](vkglTF::Model::VertexFormat format) { return std::string(format == vkglTF::Model::VERTEX_FORMAT_COMPACT ? "compact" : "full"); };
+		vks::tools::exitFatal("Model \"" + modelName + "\" uses the " + formatName(model->vertexFormat) + " vertex format, but pipeline \"" + pipelineName + "\" expects the " + formatName(pipeline->getModelVertexFormat()) + " format", -1);
+	}
+}
+
 RenderPass* VulkanRenderer::addRenderPass(std::string name)
 {
 	RenderPass* renderPass = new RenderPass(device->handle);
@@ -974,7 +1171,7 @@ RenderPass* VulkanRenderer::addRenderPass(std::string name)
 	return renderPass;
 }
 
-RenderPass* VulkanRenderer::getRenderPass(std::string name)
+RenderPass* VulkanRenderer::getRenderPass(const std::string& name)
 {
 	assert(renderPasses.count(name) > 0);
 	return renderPasses[name];
@@ -987,7 +1184,7 @@ DescriptorSetLayout* VulkanRenderer::addDescriptorSetLayout(std::string name)
 	return descriptorSetLayout;
 }
 
-DescriptorSetLayout* VulkanRenderer::getDescriptorSetLayout(std::string name)
+DescriptorSetLayout* VulkanRenderer::getDescriptorSetLayout(const std::string& name)
 {
 	return descriptorSetLayouts[name];
 }
@@ -34,6 +34,10 @@
 #include <string>
 #include <array>
 #include <numeric>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <atomic>
 
 #include "vulkan/vulkan.h"
 
@@ -55,6 +59,11 @@
 #include "DescriptorSet.h"
 #include "DescriptorSetLayout.h"
 #include "DescriptorPool.h"
+#include "DescriptorAllocator.h"
+#include "UploadManager.h"
+#include "SamplerCache.h"
+#include "TransformBuffer.h"
+#include "InstanceBuffer.h"
 
 #include "LightSource.h"
 
@@ -73,6 +82,7 @@ struct FrameBufferAttachment {
 class VulkanRenderer
 {
 private:	
+	// Only accessed from the main thread, the worker threads in loadPipelines never touch the registries
 	std::unordered_map<std::string, Pipeline*> pipelines;
 	std::unordered_map<std::string, PipelineLayout*> pipelineLayouts;
 	std::unordered_map<std::string, RenderPass*> renderPasses;
@@ -94,9 +104,32 @@ private:
 	void setupDepthStencil();
 	void setupFrameBuffer();
 	void setupLayouts();
-	void setupDescriptorPool();
-
-	Pipeline* loadPipelineFromFile(std::string filename);
+	void setupDescriptorAllocator();
+
+	// Pipeline description read from a JSON file
+	// Owns all state referenced by the create info, so it can be parsed on a worker thread and created later on
+	struct PipelineDefinition {
+		std::string filename;
+		std::string name;
+		std::string layout;
+		std::string renderPass;
+		// Set for pipelines of optional features, these are skipped instead of failing if their layout doesn't exist
+		bool optional = false;
+		Pipeline* pipeline = nullptr;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI;
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI;
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI;
+		VkPipelineViewportStateCreateInfo viewportStateCI;
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI;
+		std::vector<VkDynamicState> dynamicStateEnables;
+		VkPipelineDynamicStateCreateInfo dynamicStateCI;
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates;
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI;
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes;
+		VkPipelineVertexInputStateCreateInfo vertexInputState;
+	};
+	bool loadPipelineDefinition(PipelineDefinition& definition);
 	void loadPipelines();
 protected:
 	VkPhysicalDevice physicalDevice;
@@ -119,7 +152,12 @@ public:
 	uint32_t renderHeight;
 
 	VkPipelineCache pipelineCache;
-	DescriptorPool* descriptorPool;
+	// All descriptor sets (except the debug UI's) are allocated from here
+	DescriptorAllocator* descriptorAllocator;
+	// Model matrices of all entities, see descriptorSets.transforms
+	TransformBuffer* transformBuffer;
+	// Per-frame instance data, e.g. the model matrices of instanced servants
+	InstanceBuffer* instanceBuffer;
 	Device* device;
 
 	std::vector<VkFramebuffer>frameBuffers;
@@ -146,6 +184,8 @@ public:
 	struct DescriptorSets {
 		DescriptorSet* debugquad;
 		DescriptorSet* camera;
+		// Bind with the dynamic offset of the entity's slot in the transform buffer
+		DescriptorSet* transforms;
 	} descriptorSets;
 
 	// @todo: Multiple frames in flight
@@ -170,6 +210,9 @@ public:
 	struct DeferredComposition {
 		DescriptorSet* descriptorSet;
 		Buffer lightsBuffer;
+		// Looked up once, as they're used every frame
+		RenderPass* renderPass = nullptr;
+		PipelineLayout* pipelineLayout = nullptr;
 	} deferredComposition;
 
 	// Buffers 
@@ -208,11 +251,13 @@ public:
 	void addLight(LightSource lightSource);
 
 	PipelineLayout* addPipelineLayout(std::string name);
-	PipelineLayout* getPipelineLayout(std::string name);
+	PipelineLayout* getPipelineLayout(const std::string& name);
 	Pipeline* addPipeline(std::string name);
-	Pipeline* getPipeline(std::string name);
+	void addPipeline(std::string name, Pipeline* pipeline);
+	Pipeline* getPipeline(const std::string& name);
+	void checkModelVertexFormat(const std::string& pipelineName, const std::string& modelName);
 	RenderPass* addRenderPass(std::string name);
-	RenderPass* getRenderPass(std::string name);
+	RenderPass* getRenderPass(const std::string& name);
 	DescriptorSetLayout* addDescriptorSetLayout(std::string name);
-	DescriptorSetLayout* getDescriptorSetLayout(std::string name);
+	DescriptorSetLayout* getDescriptorSetLayout(const std::string& name);
 };
\ No newline at end of file
@@ -5,17 +5,190 @@
  */
 
 #include "VulkanglTFModel.h"
-
-// Changing this value here also requires changing it in the vertex shader
-#define MAX_NUM_JOINTS 128u
+#include "UploadManager.h"
+#include "TextureCache.h"
+#include "Texture.h"
+#include "SamplerCache.h"
+
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <sstream>
+#include <iomanip>
 
 namespace vkglTF
 {
 	VkDescriptorSetLayout materialDescriptorSetLayout = VK_NULL_HANDLE;
-	VkDescriptorPool materialDescriptorPool = VK_NULL_HANDLE;
+	DescriptorAllocator* descriptorAllocator = nullptr;
 	VkDescriptorImageInfo emptyTextureImageDescriptor;
 
-	PushConstBlockMaterial pushConstBlockMaterial;
+	/*
+		Baked model file layout
+		Header followed by vertices, indices, materials, primitives, nodes and the node name table
+		Sections are referenced by their offset from the start of the file and 16 byte aligned
+		Bump the version whenever the layout or the vertex format changes
+	*/
+	const char BAKED_MODEL_MAGIC[4] = { 'V', 'W', 'M', 'D' };
+	const uint32_t BAKED_MODEL_VERSION = 5;
+
+	struct BakedModelHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t materialCount;
+		uint32_t primitiveCount;
+		uint32_t nodeCount;
+		// Combined size and latest modification time of the glTF file and all files it references, used to detect stale baked files
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t materialOffset;
+		uint64_t primitiveOffset;
+		uint64_t nodeOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+		uint32_t vertexFormat;
+		glm::vec4 positionCenterExtent;
+		// Size of an index in bytes (2 or 4)
+		uint32_t indexSize;
+		// Newline separated paths of the external files referenced by the glTF file, relative to it
+		uint64_t dependenciesOffset;
+		uint64_t dependenciesSize;
+	};
+
+	struct BakedMaterial {
+		enum Flags { METALLIC_ROUGHNESS = 1, SPECULAR_GLOSSINESS = 2, DESCRIPTOR_SET = 4 };
+		glm::vec4 baseColorFactor;
+		glm::vec4 emissiveFactor;
+		glm::vec4 diffuseFactor;
+		glm::vec3 specularFactor;
+		float alphaCutoff;
+		float metallicFactor;
+		float roughnessFactor;
+		uint32_t alphaMode;
+		uint32_t flags;
+		Material::TexCoordSets texCoordSets;
+	};
+
+	struct BakedPrimitive {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+		uint32_t material;
+		glm::vec3 bbMin;
+		uint32_t bbValid;
+		glm::vec3 bbMax;
+	};
+
+	struct BakedNode {
+		// Nodes are stored in the order of Model::linearNodes, children come before their parent
+		int32_t parent;
+		uint32_t index;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		glm::mat4 matrix;
+		glm::quat rotation;
+		glm::vec3 translation;
+		glm::vec3 scale;
+		uint32_t hasMesh;
+		uint32_t firstPrimitive;
+		uint32_t primitiveCount;
+		uint32_t meshBBValid;
+		glm::vec3 meshBBMin;
+		glm::vec3 meshBBMax;
+	};
+
+	static_assert(std::is_trivially_copyable<Model::Vertex>::value && std::is_trivially_copyable<Model::CompactVertex>::value && std::is_trivially_copyable<BakedMaterial>::value && std::is_trivially_copyable<BakedPrimitive>::value && std::is_trivially_copyable<BakedNode>::value, "Baked model data must be trivially copyable");
+
+	// Combined size and latest modification time of a glTF file and the external files it references
+	// Fails if any of the files is missing, so a baked file is considered stale if a dependency was removed
+	bool getBakeSourceStamp(const std::string& filename, const std::vector<std::string>& dependencies, uint64_t& size, int64_t& time)
+	{
+		size = 0;
+		time = 0;
+		const std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+		std::vector<std::filesystem::path> paths = { std::filesystem::path(filename) };
+		for (const std::string& dependency : dependencies) {
+			paths.push_back(directory / dependency);
+		}
+		for (const std::filesystem::path& path : paths) {
+			std::error_code error;
+			if (!std::filesystem::exists(path, error)) {
+				return false;
+			}
+			size += std::filesystem::file_size(path, error);
+			time = std::max(time, (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count());
+			if (error) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// External buffers and images of a glTF file, embedded data uris are covered by the glTF file itself
+	std::vector<std::string> getBakeDependencies(const tinygltf::Model& gltfModel)
+	{
+		std::vector<std::string> dependencies;
+		auto addUri = [&dependencies](const std::string& uri) {
+			if (!uri.empty() && (uri.compare(0, 5, "data:") != 0) && (std::find(dependencies.begin(), dependencies.end(), uri) == dependencies.end())) {
+				dependencies.push_back(uri);
+			}
+		};
+		for (const tinygltf::Buffer& buffer : gltfModel.buffers) {
+			addUri(buffer.uri);
+		}
+		for (const tinygltf::Image& image : gltfModel.images) {
+			addUri(image.uri);
+		}
+		return dependencies;
+	}
+
+	struct ImageLoaderSettings {
+		std::string cacheDirectory;
+		TextureCache::Format format;
+	};
+
+	// Image loader for tinygltf that goes through the texture cache instead of decoding images at every start
+	// On a cache hit the pre-converted KTX file is read, otherwise the image is decoded once, converted and written to the cache
+	// If requested, the RGBA8 version is block compressed to the device's format (and cached) too
+	// The image data is replaced with the contents of the KTX file
+	bool loadglTFImageData(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int requestedWidth, int requestedHeight, const unsigned char* data, int size, void* userData)
+	{
+		const ImageLoaderSettings& settings = *static_cast<const ImageLoaderSettings*>(userData);
+		uint32_t width, height;
+		const bool compress = (settings.format != TextureCache::FORMAT_RGBA8);
+		const std::string compressedFilename = TextureCache::getFilename(settings.cacheDirectory, data, size, settings.format);
+		if (!compress || !TextureCache::load(compressedFilename, image->image, width, height)) {
+			const std::string cacheFilename = TextureCache::getFilename(settings.cacheDirectory, data, size);
+			if (!TextureCache::load(cacheFilename, image->image, width, height)) {
+				if (!TextureCache::convert(data, size, image->image, width, height)) {
+					if (error) {
+						*error += "Could not decode image " + std::to_string(imageIndex) + " \"" + image->uri + "\"\n";
+					}
+					return false;
+				}
+				if (TextureCache::write(cacheFilename, image->image, true)) {
+					std::clog << "Image " + std::to_string(imageIndex) + " converted to " + cacheFilename + "\n";
+				}
+			}
+			std::vector<unsigned char> compressedData;
+			if (compress && TextureCache::compress(image->image, settings.format, compressedData)) {
+				std::swap(image->image, compressedData);
+				TextureCache::write(compressedFilename, image->image);
+			}
+		}
+		image->width = width;
+		image->height = height;
+		image->component = 4;
+		image->bits = 8;
+		image->mimeType = "image/ktx";
+		return true;
+	}
 
 	BoundingBox BoundingBox::getAABB(glm::mat4 m) {
 		glm::vec3 min = glm::vec3(m[3]);
@@ -55,212 +228,41 @@ namespace vkglTF
 			vkDestroyImageView(device->handle, view, nullptr);
 			vkDestroyImage(device->handle, image, nullptr);
 			vkFreeMemory(device->handle, deviceMemory, nullptr);
-			vkDestroySampler(device->handle, sampler, nullptr);
+			if (memorySize > 0) {
+				device->memoryTracker->free(MemoryCategory::Textures, memorySize);
+				memorySize = 0;
+			}
+			device->samplerCache->release(sampler);
 		}
 
 		/*
-			Load a texture from a glTF image (stored as vector of chars loaded via stb_image)
-			Also generates the mip chain as glTF images are stored as jpg or png without any mips
+			Load a texture from a glTF image
+			The image data has been replaced with a KTX file including the full mip chain by the texture cache at parse time (see loadglTFImageData)
 		*/
 		void Texture::fromglTfImage(tinygltf::Image& gltfimage, TextureSampler textureSampler, Device* device, VkQueue copyQueue)
 		{
 			this->device = device;
 
-			unsigned char* buffer = nullptr;
-			VkDeviceSize bufferSize = 0;
-			bool deleteBuffer = false;
-			if (gltfimage.component == 3) {
-				// Most devices don't support RGB only on Vulkan so convert if necessary
-				// TODO: Check actual format support and transform only if required
-				bufferSize = gltfimage.width * gltfimage.height * 4;
-				buffer = new unsigned char[bufferSize];
-				unsigned char* rgba = buffer;
-				unsigned char* rgb = &gltfimage.image[0];
-				for (int32_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-					for (int32_t j = 0; j < 3; ++j) {
-						rgba[j] = rgb[j];
-					}
-					rgba += 4;
-					rgb += 3;
-				}
-				deleteBuffer = true;
-			}
-			else {
-				buffer = &gltfimage.image[0];
-				bufferSize = gltfimage.image.size();
-			}
-
-			VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-
-			VkFormatProperties formatProperties;
-
-			width = gltfimage.width;
-			height = gltfimage.height;
-			mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-			VkMemoryAllocateInfo memAllocInfo{};
-			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			VkMemoryRequirements memReqs{};
-
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo{};
-			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			bufferCreateInfo.size = bufferSize;
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(device->handle, &bufferCreateInfo, nullptr, &stagingBuffer));
-			vkGetBufferMemoryRequirements(device->handle, stagingBuffer, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->handle, stagingBuffer, stagingMemory, 0));
-
-			uint8_t* data;
-			VK_CHECK_RESULT(vkMapMemory(device->handle, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-			memcpy(data, buffer, bufferSize);
-			vkUnmapMemory(device->handle, stagingMemory);
-
-			VkImageCreateInfo imageCreateInfo{};
-			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-			VK_CHECK_RESULT(vkCreateImage(device->handle, &imageCreateInfo, nullptr, &image));
-			vkGetImageMemoryRequirements(device->handle, image, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->handle, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->handle, image, deviceMemory, 0));
-
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.levelCount = 1;
-			subresourceRange.layerCount = 1;
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = 0;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = width;
-			bufferCopyRegion.imageExtent.height = height;
-			bufferCopyRegion.imageExtent.depth = 1;
-
-			vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-			vkFreeMemory(device->handle, stagingMemory, nullptr);
-			vkDestroyBuffer(device->handle, stagingBuffer, nullptr);
-
-			// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-			VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			for (uint32_t i = 1; i < mipLevels; i++) {
-				VkImageBlit imageBlit{};
-
-				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.srcSubresource.layerCount = 1;
-				imageBlit.srcSubresource.mipLevel = i - 1;
-				imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-				imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-				imageBlit.srcOffsets[1].z = 1;
-
-				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.dstSubresource.layerCount = 1;
-				imageBlit.dstSubresource.mipLevel = i;
-				imageBlit.dstOffsets[1].x = int32_t(width >> i);
-				imageBlit.dstOffsets[1].y = int32_t(height >> i);
-				imageBlit.dstOffsets[1].z = 1;
-
-				VkImageSubresourceRange mipSubRange = {};
-				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				mipSubRange.baseMipLevel = i;
-				mipSubRange.levelCount = 1;
-				mipSubRange.layerCount = 1;
-
-				{
-					VkImageMemoryBarrier imageMemoryBarrier{};
-					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-					imageMemoryBarrier.srcAccessMask = 0;
-					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-					imageMemoryBarrier.image = image;
-					imageMemoryBarrier.subresourceRange = mipSubRange;
-					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-				}
-
-				vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-				{
-					VkImageMemoryBarrier imageMemoryBarrier{};
-					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-					imageMemoryBarrier.image = image;
-					imageMemoryBarrier.subresourceRange = mipSubRange;
-					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-				}
-			}
-
-			subresourceRange.levelCount = mipLevels;
-			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			device->flushCommandBuffer(blitCmd, copyQueue, true);
+			assert(gltfimage.mimeType == "image/ktx");
+			// Depending on device support, images have been block compressed on the loader threads
+			ktxTexture* ktxTexture;
+			ktxResult result = ktxTexture_CreateFromMemory(gltfimage.image.data(), gltfimage.image.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+			assert(result == KTX_SUCCESS);
+
+			// Image creation and upload go through the same path as KTX files loaded from disk
+			::Texture2D texture;
+			texture.loadFromKTXTexture(ktxTexture, device, copyQueue);
+			image = texture.image;
+			imageLayout = texture.imageLayout;
+			deviceMemory = texture.deviceMemory;
+			memorySize = texture.memorySize;
+			view = texture.view;
+			width = texture.width;
+			height = texture.height;
+			mipLevels = texture.mipLevels;
+			layerCount = 1;
+			// Replace the default sampler with the one from the glTF file
+			device->samplerCache->release(texture.sampler);
 
 			VkSamplerCreateInfo samplerInfo{};
 			samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -272,31 +274,13 @@ namespace vkglTF
 			samplerInfo.addressModeW = textureSampler.addressModeW;
 			samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
 			samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			samplerInfo.maxAnisotropy = 1.0;
-			samplerInfo.anisotropyEnable = VK_FALSE;
-			samplerInfo.maxLod = (float)mipLevels;
+			samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 			samplerInfo.maxAnisotropy = 8.0f;
 			samplerInfo.anisotropyEnable = VK_TRUE;
-			VK_CHECK_RESULT(vkCreateSampler(device->handle, &samplerInfo, nullptr, &sampler));
-
-			VkImageViewCreateInfo viewInfo{};
-			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			viewInfo.image = image;
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			viewInfo.format = format;
-			viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			viewInfo.subresourceRange.layerCount = 1;
-			viewInfo.subresourceRange.levelCount = mipLevels;
-			VK_CHECK_RESULT(vkCreateImageView(device->handle, &viewInfo, nullptr, &view));
-
-			descriptor.sampler = sampler;
-			descriptor.imageView = view;
-			descriptor.imageLayout = imageLayout;
-
-			if (deleteBuffer)
-				delete[] buffer;
+			// Samplers are shared, glTF files usually only use a handful of different sampler states
+			sampler = device->samplerCache->acquire(samplerInfo);
 
+			updateDescriptor();
 		}
 
 		Primitive::Primitive(uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), vertexCount(vertexCount), material(material) {
@@ -318,7 +302,8 @@ namespace vkglTF
 				VMA_MEMORY_USAGE_CPU_TO_GPU,
 				&uniformBuffer.buffer,
 				sizeof(uniformBlock),
-				&uniformBlock));
+				&uniformBlock,
+				MemoryCategory::Uniforms));
 		};
 
 		Mesh::~Mesh() {
@@ -337,40 +322,68 @@ namespace vkglTF
 			return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 		}
 
+		// Returns the cached world matrix, recalculating it and any outdated parent matrices first
 		glm::mat4 Node::getMatrix() {
-			glm::mat4 m = localMatrix();
-			vkglTF::Node* p = parent;
-			while (p) {
-				m = p->localMatrix() * m;
-				p = p->parent;
+			if (!worldMatrixValid) {
+				worldMatrix = parent ? parent->getMatrix() * localMatrix() : localMatrix();
+				worldMatrixValid = true;
 			}
-			return m;
+			return worldMatrix;
 		}
 
-		void Node::update() {
-			if (mesh) {
-				glm::mat4 m = getMatrix();
-				if (skin) {
-					mesh->uniformBlock.matrix = m;
-					// Update join matrices
-					glm::mat4 inverseTransform = glm::inverse(m);
-					size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-					for (size_t i = 0; i < numJoints; i++) {
-						vkglTF::Node* jointNode = skin->joints[i];
-						glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-						jointMat = inverseTransform * jointMat;
-						mesh->uniformBlock.jointMatrix[i] = jointMat;
-					}
-					mesh->uniformBlock.jointcount = (float)numJoints;
-					memcpy(mesh->uniformBuffer.buffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-				}
-				else {
-					memcpy(mesh->uniformBuffer.buffer.mapped, &m, sizeof(glm::mat4));
+		// Has to be called after changing the node's local transformation
+		void Node::setDirty() {
+			dirty = true;
+			invalidateWorldMatrix();
+		}
+
+		// A node with an invalid world matrix never has valid children, so already invalid subtrees are skipped
+		void Node::invalidateWorldMatrix() {
+			if (worldMatrixValid) {
+				worldMatrixValid = false;
+				for (auto& child : children) {
+					child->invalidateWorldMatrix();
 				}
 			}
+		}
 
+		// Recalculates the cached world matrices of this node and its children top-down if the node or one of its parents changed
+		// Returns true if any matrix in the subtree changed
+		bool Node::updateWorldMatrix(bool parentChanged) {
+			const bool changed = dirty || parentChanged;
+			if (changed) {
+				getMatrix();
+				dirty = false;
+				// Skinned meshes depend on their joints and are updated by the model once all matrices are up to date
+				if (mesh && !skin) {
+					update();
+				}
+			}
+			bool subtreeChanged = changed;
 			for (auto& child : children) {
-				child->update();
+				subtreeChanged |= child->updateWorldMatrix(changed);
+			}
+			return subtreeChanged;
+		}
+
+		// Writes the node's world matrix to the mesh's uniform buffer
+		// Joint matrices of skinned meshes are written to the skin's range of the shared joint buffer
+		void Node::update() {
+			if (mesh) {
+				mesh->uniformBlock.matrix = worldMatrix;
+				if (skin && skin->jointMatrices) {
+					glm::mat4 inverseTransform = glm::inverse(worldMatrix);
+					for (size_t i = 0; i < skin->joints.size(); i++) {
+						glm::mat4 jointMat = skin->joints[i]->getMatrix();
+						if (i < skin->inverseBindMatrices.size()) {
+							jointMat = jointMat * skin->inverseBindMatrices[i];
+						}
+						skin->jointMatrices[i] = inverseTransform * jointMat;
+					}
+					mesh->uniformBlock.firstJoint = skin->firstJoint;
+					mesh->uniformBlock.jointCount = static_cast<uint32_t>(skin->joints.size());
+				}
+				memcpy(mesh->uniformBuffer.buffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
 			}
 		}
 
@@ -412,6 +425,25 @@ namespace vkglTF
 			return pt;
 		}
 
+		// Finds the keyframe interval [inputs[index], inputs[index + 1]] containing the given time, returns false if the time is outside of the keyframes
+		// The cursor stores the last interval per channel, as playback usually stays in it or advances to the next one, other cases use a binary search
+		bool AnimationSampler::findKeyframe(float time, size_t& cursor, size_t& index) const
+		{
+			if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back())) {
+				return false;
+			}
+			const size_t lastInterval = inputs.size() - 2;
+			for (size_t i = cursor; i <= std::min(cursor + 1, lastInterval); i++) {
+				if ((time >= inputs[i]) && ((time < inputs[i + 1]) || (i == lastInterval))) {
+					cursor = index = i;
+					return true;
+				}
+			}
+			const size_t upper = std::distance(inputs.begin(), std::upper_bound(inputs.begin(), inputs.end(), time));
+			cursor = index = std::min(upper - 1, lastInterval);
+			return true;
+		}
+
 		void AnimationSampler::translate(size_t index, float time, vkglTF::Node* node)
 		{
 			switch (interpolation) {
@@ -491,15 +523,14 @@ namespace vkglTF
 	
 		void Model::destroy(VkDevice device)
 		{
+			// Geometry buffers are created through VMA and tracked, so they have to be released by the buffer itself
 			if (vertices.buffer != VK_NULL_HANDLE) {
-				vkDestroyBuffer(device, vertices.buffer, nullptr);
-				vkFreeMemory(device, vertices.memory, nullptr);
+				vertices.destroy();
 			}
 			if (indices.buffer != VK_NULL_HANDLE) {
-				vkDestroyBuffer(device, indices.buffer, nullptr);
-				vkFreeMemory(device, indices.memory, nullptr);
+				indices.destroy();
 			}
-			for (auto texture : textures) {
+			for (auto& texture : textures) {
 				texture.destroy();
 			}
 			textures.resize(0);
@@ -507,6 +538,11 @@ namespace vkglTF
 			for (auto node : nodes) {
 				delete node;
 			}
+			for (auto& material : materials) {
+				if (material.descriptorSet != VK_NULL_HANDLE) {
+					descriptorAllocator->free(material.descriptorSet);
+				}
+			}
 			materials.resize(0);
 			animations.resize(0);
 			nodes.resize(0);
@@ -666,7 +702,16 @@ namespace vkglTF
 							return;
 						}
 					}
+					else
+					{
+						// Primitives are always drawn indexed, so non-indexed ones get a sequential index list
+						indexCount = vertexCount;
+						for (uint32_t index = 0; index < vertexCount; index++) {
+							indexBuffer.push_back(index + vertexStart);
+						}
+					}
 					Primitive* newPrimitive = new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+					newPrimitive->hasIndices = hasIndices;
 					newPrimitive->setBoundingBox(posMin, posMax);
 					newMesh->primitives.push_back(newPrimitive);
 				}
@@ -718,6 +763,14 @@ namespace vkglTF
 					memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
 				}
 
+				// Reserve space for the joint matrices in the shared joint buffer
+				if (jointBuffer && !newSkin->joints.empty()) {
+					newSkin->jointMatrices = jointBuffer->allocate(static_cast<uint32_t>(newSkin->joints.size()), newSkin->firstJoint);
+				}
+				if (!newSkin->jointMatrices) {
+					std::cerr << "Joint buffer is full or missing, skin \"" + newSkin->name + "\" is not animated\n";
+				}
+
 				skins.push_back(newSkin);
 			}
 		}
@@ -725,7 +778,7 @@ namespace vkglTF
 		void Model::loadTextures(tinygltf::Model& gltfModel, Device* device, VkQueue transferQueue)
 		{
 			for (tinygltf::Texture& tex : gltfModel.textures) {
-				tinygltf::Image image = gltfModel.images[tex.source];
+				tinygltf::Image& image = gltfModel.images[tex.source];
 				vkglTF::TextureSampler textureSampler;
 				if (tex.sampler == -1) {
 					// No sampler specified, use a default one
@@ -995,15 +1048,22 @@ namespace vkglTF
 			}
 		}
 
-		void Model::loadFromFile(std::string filename, Device* device, VkQueue transferQueue, float scale)
+		std::string Model::getTextureCacheDirectory(std::string filename)
+		{
+			return TextureCache::getDirectory(filename);
+		}
+
+		// Parses a glTF file including all external resources (buffers, images) into memory
+		// Doesn't touch any Vulkan objects, so this can be run on any thread
+		// Images are block compressed to the given format, only pass a format the device supports (see Texture::getCompressionFormat)
+		bool Model::loadglTFFile(std::string filename, tinygltf::Model& gltfModel, TextureCache::Format textureFormat)
 		{
-			tinygltf::Model gltfModel;
 			tinygltf::TinyGLTF gltfContext;
+			ImageLoaderSettings imageLoaderSettings{ getTextureCacheDirectory(filename), textureFormat };
+			gltfContext.SetImageLoader(loadglTFImageData, &imageLoaderSettings);
 			std::string error;
 			std::string warning;
 
-			this->device = device;
-
 			bool binary = false;
 			size_t extpos = filename.rfind('.', filename.length());
 			if (extpos != std::string::npos) {
@@ -1011,69 +1071,524 @@ namespace vkglTF
 			}
 
 			bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, filename.c_str()) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename.c_str());
+			if (!fileLoaded) {
+				// TODO: throw
+				std::cerr << "Could not load gltf file " + filename + ": " + error + "\n";
+			}
+			return fileLoaded;
+		}
+
+		// Prefers an up to date baked version of the model, falls back to the glTF file (and bakes it) otherwise
+		// If forceBake is set, the glTF file is always loaded and the baked file rewritten
+		void Model::loadFromFile(std::string filename, Device* device, VkQueue transferQueue, float scale, bool forceBake)
+		{
+			MappedFile bakedFile;
+			if (!forceBake && openBakedFile(getBakedFilename(filename), filename, bakedFile)) {
+				loadFromBakedFile(bakedFile, device, transferQueue);
+				return;
+			}
+			tinygltf::Model gltfModel;
+			if (loadglTFFile(filename, gltfModel, Texture::getCompressionFormat(device))) {
+				loadFromglTFModel(gltfModel, device, transferQueue, scale, filename, true);
+			}
+		}
+
+		// Creates the Vulkan resources for a parsed glTF model and uploads them
+		// If bake is set, a baked version of the model is written next to the source file
+		void Model::loadFromglTFModel(tinygltf::Model& gltfModel, Device* device, VkQueue transferQueue, float scale, std::string sourceFilename, bool bake)
+		{
+			this->device = device;
 
 			std::vector<uint32_t> indexBuffer;
 			std::vector<Vertex> vertexBuffer;
 
-			if (fileLoaded) {
-				loadTextureSamplers(gltfModel);
-				loadTextures(gltfModel, device, transferQueue);
-				loadMaterials(gltfModel);
-				// TODO: scene handling with no default scene
-				const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-				for (size_t i = 0; i < scene.nodes.size(); i++) {
-					const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-					loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			loadTextureSamplers(gltfModel);
+			loadTextures(gltfModel, device, transferQueue);
+			loadMaterials(gltfModel);
+			uploadMaterials();
+			// TODO: scene handling with no default scene
+			const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			}
+			if (gltfModel.animations.size() > 0) {
+				loadAnimations(gltfModel);
+			}
+			loadSkins(gltfModel);
+
+			// Assign skins
+			for (auto node : linearNodes) {
+				if (node->skinIndex > -1) {
+					node->skin = skins[node->skinIndex];
+				}
+			}
+			// Initial pose
+			updateNodes();
+
+			extensions = gltfModel.extensionsUsed;
+
+			assert(vertexBuffer.size() > 0);
+			optimizeGeometry(indexBuffer, vertexBuffer, sourceFilename);
+
+			// Static meshes use the compact vertex layout
+			vertexFormat = selectVertexFormat(gltfModel);
+			std::vector<CompactVertex> compactVertexBuffer;
+			const void* vertexData = vertexBuffer.data();
+			if (vertexFormat == VERTEX_FORMAT_COMPACT) {
+				compactVertexBuffer = compressVertices(vertexBuffer);
+				vertexData = compactVertexBuffer.data();
+			}
+			// Meshes with less than 64k vertices use 16 bit indices
+			indexType = (vertexBuffer.size() < 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			std::vector<uint16_t> indexBuffer16;
+			const void* indexData = indexBuffer.data();
+			if (indexType == VK_INDEX_TYPE_UINT16) {
+				indexBuffer16.assign(indexBuffer.begin(), indexBuffer.end());
+				indexData = indexBuffer16.data();
+			}
+			createGeometryBuffers(vertexData, static_cast<uint32_t>(vertexBuffer.size()), indexData, static_cast<uint32_t>(indexBuffer.size()));
+
+			getSceneDimensions();
+
+			if (bake && !sourceFilename.empty() && isBakeable(gltfModel)) {
+				writeBakedFile(getBakedFilename(sourceFilename), sourceFilename, getBakeDependencies(gltfModel), indexData, static_cast<uint32_t>(indexBuffer.size()), vertexData, static_cast<uint32_t>(vertexBuffer.size()));
+			}
+		}
+
+		std::string Model::getBakedFilename(std::string filename)
+		{
+			return std::filesystem::path(filename).replace_extension(".vwm").string();
+		}
+
+		// The baked format only stores geometry, the node hierarchy and material parameters
+		bool Model::isBakeable(const tinygltf::Model& gltfModel)
+		{
+			return gltfModel.images.empty() && gltfModel.skins.empty() && gltfModel.animations.empty();
+		}
+
+		// Maps a baked model file and checks if it's valid and up to date with its source file and all files that one references
+		bool Model::openBakedFile(std::string filename, std::string sourceFilename, MappedFile& file)
+		{
+			if (!file.open(filename)) {
+				return false;
+			}
+			bool valid = (file.size >= sizeof(BakedModelHeader));
+			if (valid) {
+				const BakedModelHeader* header = reinterpret_cast<const BakedModelHeader*>(file.data);
+				valid = (memcmp(header->magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC)) == 0)
+					&& (header->version == BAKED_MODEL_VERSION)
+					&& (header->dependenciesOffset + header->dependenciesSize <= file.size);
+			}
+			if (valid) {
+				const BakedModelHeader* header = reinterpret_cast<const BakedModelHeader*>(file.data);
+				std::vector<std::string> dependencies;
+				const char* dependencyData = reinterpret_cast<const char*>(file.data + header->dependenciesOffset);
+				size_t start = 0;
+				for (size_t i = 0; i <= header->dependenciesSize; i++) {
+					if ((i == header->dependenciesSize) || (dependencyData[i] == '\n')) {
+						if (i > start) {
+							dependencies.push_back(std::string(dependencyData + start, i - start));
+						}
+						start = i + 1;
+					}
+				}
+				uint64_t sourceSize;
+				int64_t sourceTime;
+				valid = getBakeSourceStamp(sourceFilename, dependencies, sourceSize, sourceTime)
+					&& ((header->vertexFormat == VERTEX_FORMAT_FULL) || (header->vertexFormat == VERTEX_FORMAT_COMPACT))
+					&& (header->vertexSize == getVertexStride(static_cast<VertexFormat>(header->vertexFormat)))
+					&& (header->sourceSize == sourceSize)
+					&& (header->sourceTime == sourceTime)
+					&& (header->vertexOffset + (uint64_t)header->vertexCount * header->vertexSize <= file.size)
+					&& ((header->indexSize == sizeof(uint16_t)) || (header->indexSize == sizeof(uint32_t)))
+					&& (header->indexOffset + (uint64_t)header->indexCount * header->indexSize <= file.size)
+					&& (header->materialOffset + (uint64_t)header->materialCount * sizeof(BakedMaterial) <= file.size)
+					&& (header->primitiveOffset + (uint64_t)header->primitiveCount * sizeof(BakedPrimitive) <= file.size)
+					&& (header->nodeOffset + (uint64_t)header->nodeCount * sizeof(BakedNode) <= file.size)
+					&& (header->namesOffset + header->namesSize <= file.size)
+					&& (header->vertexCount > 0)
+					&& (header->materialCount > 0);
+			}
+			if (!valid) {
+				file.close();
+			}
+			return valid;
+		}
+
+		// Creates the Vulkan resources for a mapped baked model file and uploads the vertex and index data straight from the mapping
+		void Model::loadFromBakedFile(const MappedFile& file, Device* device, VkQueue transferQueue)
+		{
+			this->device = device;
+
+			const BakedModelHeader* header = reinterpret_cast<const BakedModelHeader*>(file.data);
+			const BakedMaterial* bakedMaterials = reinterpret_cast<const BakedMaterial*>(file.data + header->materialOffset);
+			const BakedPrimitive* bakedPrimitives = reinterpret_cast<const BakedPrimitive*>(file.data + header->primitiveOffset);
+			const BakedNode* bakedNodes = reinterpret_cast<const BakedNode*>(file.data + header->nodeOffset);
+			const char* names = reinterpret_cast<const char*>(file.data + header->namesOffset);
+
+			// Materials need to be complete before primitives reference them
+			materials.reserve(header->materialCount);
+			for (uint32_t i = 0; i < header->materialCount; i++) {
+				const BakedMaterial& source = bakedMaterials[i];
+				vkglTF::Material material{};
+				material.device = device;
+				material.baseColorFactor = source.baseColorFactor;
+				material.emissiveFactor = source.emissiveFactor;
+				material.extension.diffuseFactor = source.diffuseFactor;
+				material.extension.specularFactor = source.specularFactor;
+				material.alphaCutoff = source.alphaCutoff;
+				material.metallicFactor = source.metallicFactor;
+				material.roughnessFactor = source.roughnessFactor;
+				material.alphaMode = static_cast<Material::AlphaMode>(source.alphaMode);
+				material.texCoordSets = source.texCoordSets;
+				material.pbrWorkflows.metallicRoughness = (source.flags & BakedMaterial::METALLIC_ROUGHNESS) != 0;
+				material.pbrWorkflows.specularGlossiness = (source.flags & BakedMaterial::SPECULAR_GLOSSINESS) != 0;
+				if (source.flags & BakedMaterial::DESCRIPTOR_SET) {
+					material.createDescriptorSet();
+				}
+				materials.push_back(material);
+			}
+			uploadMaterials();
+
+			linearNodes.resize(header->nodeCount);
+			for (uint32_t i = 0; i < header->nodeCount; i++) {
+				const BakedNode& source = bakedNodes[i];
+				vkglTF::Node* newNode = new Node{};
+				newNode->index = source.index;
+				newNode->name = (source.nameOffset + source.nameLength <= header->namesSize) ? std::string(names + source.nameOffset, source.nameLength) : "";
+				newNode->matrix = source.matrix;
+				newNode->rotation = source.rotation;
+				newNode->translation = source.translation;
+				newNode->scale = source.scale;
+				if (source.hasMesh) {
+					Mesh* newMesh = new Mesh(device, newNode->matrix);
+					for (uint32_t p = source.firstPrimitive; p < source.firstPrimitive + source.primitiveCount && p < header->primitiveCount; p++) {
+						const BakedPrimitive& primitive = bakedPrimitives[p];
+						Primitive* newPrimitive = new Primitive(primitive.firstIndex, primitive.indexCount, primitive.vertexCount, materials[std::min(primitive.material, header->materialCount - 1)]);
+						if (primitive.bbValid) {
+							newPrimitive->setBoundingBox(primitive.bbMin, primitive.bbMax);
+						}
+						newMesh->primitives.push_back(newPrimitive);
+					}
+					newMesh->bb = BoundingBox(source.meshBBMin, source.meshBBMax);
+					newMesh->bb.valid = source.meshBBValid != 0;
+					newNode->mesh = newMesh;
 				}
-				if (gltfModel.animations.size() > 0) {
-					loadAnimations(gltfModel);
+				linearNodes[i] = newNode;
+			}
+			// Children are stored before their parents, so walking in order restores the original child order
+			for (uint32_t i = 0; i < header->nodeCount; i++) {
+				const int32_t parent = bakedNodes[i].parent;
+				if ((parent >= 0) && ((uint32_t)parent < header->nodeCount)) {
+					linearNodes[i]->parent = linearNodes[parent];
+					linearNodes[parent]->children.push_back(linearNodes[i]);
+				}
+				else {
+					nodes.push_back(linearNodes[i]);
 				}
-				loadSkins(gltfModel);
+			}
+
+			// Initial pose
+			updateNodes();
+
+			// Data is copied into the staging arena right away, so the file can be unmapped once this returns
+			vertexFormat = static_cast<VertexFormat>(header->vertexFormat);
+			positionCenterExtent = header->positionCenterExtent;
+			indexType = (header->indexSize == sizeof(uint16_t)) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			createGeometryBuffers(file.data + header->vertexOffset, header->vertexCount, file.data + header->indexOffset, header->indexCount);
+
+			getSceneDimensions();
+		}
 
-				for (auto node : linearNodes) {
-					// Assign skins
-					if (node->skinIndex > -1) {
-						node->skin = skins[node->skinIndex];
+		// Writes the CPU side data of a loaded model into a baked model file
+		bool Model::writeBakedFile(std::string filename, std::string sourceFilename, const std::vector<std::string>& dependencies, const void* indexData, uint32_t indexCount, const void* vertexData, uint32_t vertexCount)
+		{
+			BakedModelHeader header{};
+			memcpy(header.magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC));
+			header.version = BAKED_MODEL_VERSION;
+			header.vertexFormat = vertexFormat;
+			header.vertexSize = getVertexStride(vertexFormat);
+			header.positionCenterExtent = positionCenterExtent;
+			header.indexSize = getIndexSize(indexType);
+			if (!getBakeSourceStamp(sourceFilename, dependencies, header.sourceSize, header.sourceTime)) {
+				return false;
+			}
+
+			std::vector<BakedMaterial> bakedMaterials;
+			for (size_t i = 0; i < materials.size(); i++) {
+				const Material& material = materials[i];
+				BakedMaterial bakedMaterial{};
+				bakedMaterial.baseColorFactor = material.baseColorFactor;
+				bakedMaterial.emissiveFactor = material.emissiveFactor;
+				bakedMaterial.diffuseFactor = material.extension.diffuseFactor;
+				bakedMaterial.specularFactor = material.extension.specularFactor;
+				bakedMaterial.alphaCutoff = material.alphaCutoff;
+				bakedMaterial.metallicFactor = material.metallicFactor;
+				bakedMaterial.roughnessFactor = material.roughnessFactor;
+				bakedMaterial.alphaMode = static_cast<uint32_t>(material.alphaMode);
+				bakedMaterial.texCoordSets = material.texCoordSets;
+				bakedMaterial.flags = (material.pbrWorkflows.metallicRoughness ? BakedMaterial::METALLIC_ROUGHNESS : 0)
+					| (material.pbrWorkflows.specularGlossiness ? BakedMaterial::SPECULAR_GLOSSINESS : 0)
+					| (material.descriptorSet != VK_NULL_HANDLE ? BakedMaterial::DESCRIPTOR_SET : 0);
+				bakedMaterials.push_back(bakedMaterial);
+			}
+
+			std::unordered_map<Node*, int32_t> nodeIndices;
+			for (size_t i = 0; i < linearNodes.size(); i++) {
+				nodeIndices[linearNodes[i]] = static_cast<int32_t>(i);
+			}
+			std::vector<BakedPrimitive> bakedPrimitives;
+			std::vector<BakedNode> bakedNodes;
+			std::string names;
+			for (Node* node : linearNodes) {
+				BakedNode bakedNode{};
+				bakedNode.parent = node->parent ? nodeIndices[node->parent] : -1;
+				bakedNode.index = node->index;
+				bakedNode.nameOffset = static_cast<uint32_t>(names.size());
+				bakedNode.nameLength = static_cast<uint32_t>(node->name.size());
+				names += node->name;
+				bakedNode.matrix = node->matrix;
+				bakedNode.rotation = node->rotation;
+				bakedNode.translation = node->translation;
+				bakedNode.scale = node->scale;
+				if (node->mesh) {
+					bakedNode.hasMesh = 1;
+					bakedNode.firstPrimitive = static_cast<uint32_t>(bakedPrimitives.size());
+					bakedNode.primitiveCount = static_cast<uint32_t>(node->mesh->primitives.size());
+					bakedNode.meshBBValid = node->mesh->bb.valid ? 1 : 0;
+					bakedNode.meshBBMin = node->mesh->bb.min;
+					bakedNode.meshBBMax = node->mesh->bb.max;
+					for (Primitive* primitive : node->mesh->primitives) {
+						BakedPrimitive bakedPrimitive{};
+						bakedPrimitive.firstIndex = primitive->firstIndex;
+						bakedPrimitive.indexCount = primitive->indexCount;
+						bakedPrimitive.vertexCount = primitive->vertexCount;
+						bakedPrimitive.material = static_cast<uint32_t>(&primitive->material - materials.data());
+						bakedPrimitive.bbValid = primitive->bb.valid ? 1 : 0;
+						bakedPrimitive.bbMin = primitive->bb.min;
+						bakedPrimitive.bbMax = primitive->bb.max;
+						bakedPrimitives.push_back(bakedPrimitive);
 					}
-					// Initial pose
-					if (node->mesh) {
-						node->update();
+				}
+				bakedNodes.push_back(bakedNode);
+			}
+
+			// Lay out the sections
+			auto align = [](uint64_t offset) { return (offset + 15) & ~15ull; };
+			header.vertexCount = vertexCount;
+			header.indexCount = indexCount;
+			header.materialCount = static_cast<uint32_t>(bakedMaterials.size());
+			header.primitiveCount = static_cast<uint32_t>(bakedPrimitives.size());
+			header.nodeCount = static_cast<uint32_t>(bakedNodes.size());
+			header.vertexOffset = align(sizeof(BakedModelHeader));
+			header.indexOffset = align(header.vertexOffset + (uint64_t)vertexCount * header.vertexSize);
+			header.materialOffset = align(header.indexOffset + (uint64_t)indexCount * header.indexSize);
+			header.primitiveOffset = align(header.materialOffset + bakedMaterials.size() * sizeof(BakedMaterial));
+			header.nodeOffset = align(header.primitiveOffset + bakedPrimitives.size() * sizeof(BakedPrimitive));
+			header.namesOffset = align(header.nodeOffset + bakedNodes.size() * sizeof(BakedNode));
+			header.namesSize = names.size();
+			std::string dependencyList;
+			for (const std::string& dependency : dependencies) {
+				dependencyList += dependency + "\n";
+			}
+			header.dependenciesOffset = align(header.namesOffset + names.size());
+			header.dependenciesSize = dependencyList.size();
+
+			// Write to a temporary file first so a partially written file is never picked up
+			const std::string tempFilename = filename + ".tmp";
+			{
+				std::ofstream stream(tempFilename, std::ios::binary | std::ios::trunc);
+				if (!stream.is_open()) {
+					std::cerr << "Could not write baked model file " + filename + "\n";
+					return false;
+				}
+				auto writeSection = [&stream](uint64_t offset, const void* data, size_t size) {
+					const uint64_t position = static_cast<uint64_t>(stream.tellp());
+					if (offset > position) {
+						const char padding[16] = {};
+						stream.write(padding, offset - position);
+					}
+					if (size > 0) {
+						stream.write(static_cast<const char*>(data), size);
 					}
+				};
+				writeSection(0, &header, sizeof(header));
+				writeSection(header.vertexOffset, vertexData, (size_t)vertexCount * header.vertexSize);
+				writeSection(header.indexOffset, indexData, (size_t)indexCount * header.indexSize);
+				writeSection(header.materialOffset, bakedMaterials.data(), bakedMaterials.size() * sizeof(BakedMaterial));
+				writeSection(header.primitiveOffset, bakedPrimitives.data(), bakedPrimitives.size() * sizeof(BakedPrimitive));
+				writeSection(header.nodeOffset, bakedNodes.data(), bakedNodes.size() * sizeof(BakedNode));
+				writeSection(header.namesOffset, names.data(), names.size());
+				writeSection(header.dependenciesOffset, dependencyList.data(), dependencyList.size());
+				if (!stream.good()) {
+					std::cerr << "Could not write baked model file " + filename + "\n";
+					return false;
 				}
 			}
-			else {
-				// TODO: throw
-				std::cerr << "Could not load gltf file " << filename << ": " << error << std::endl;
+			std::error_code error;
+			std::filesystem::rename(tempFilename, filename, error);
+			if (error) {
+				std::filesystem::remove(tempFilename, error);
+				return false;
+			}
+			std::clog << "Baked model written to " + filename + "\n";
+			return true;
+		}
+
+		// Skinned meshes and meshes with a second uv set need the full vertex layout
+		Model::VertexFormat Model::selectVertexFormat(const tinygltf::Model& gltfModel)
+		{
+			if (!gltfModel.skins.empty()) {
+				return VERTEX_FORMAT_FULL;
+			}
+			for (const tinygltf::Mesh& mesh : gltfModel.meshes) {
+				for (const tinygltf::Primitive& primitive : mesh.primitives) {
+					if ((primitive.attributes.count("TEXCOORD_1") > 0) || (primitive.attributes.count("JOINTS_0") > 0) || (primitive.attributes.count("WEIGHTS_0") > 0)) {
+						return VERTEX_FORMAT_FULL;
+					}
+				}
+			}
+			return VERTEX_FORMAT_COMPACT;
+		}
+
+		uint32_t Model::getVertexStride(VertexFormat vertexFormat)
+		{
+			return (vertexFormat == VERTEX_FORMAT_COMPACT) ? sizeof(CompactVertex) : sizeof(Vertex);
+		}
+
+		// Stores the shader parameters of all materials in the shared material buffer and assigns their indices
+		void Model::uploadMaterials()
+		{
+			uint32_t firstMaterial = 0;
+			if (!materialBuffer || !materialBuffer->allocate(static_cast<uint32_t>(materials.size()), firstMaterial)) {
+				std::cerr << "Material buffer is full or missing, model uses the default material\n";
 				return;
 			}
+			std::vector<ShaderMaterial> shaderMaterials(materials.size());
+			for (size_t i = 0; i < materials.size(); i++) {
+				materials[i].index = firstMaterial + static_cast<uint32_t>(i);
+				shaderMaterials[i] = materials[i].getShaderMaterial();
+			}
+			materialBuffer->upload(firstMaterial, shaderMaterials.data(), static_cast<uint32_t>(shaderMaterials.size()));
+		}
 
-			extensions = gltfModel.extensionsUsed;
+		// Size of a single index in bytes
+		uint32_t Model::getIndexSize(VkIndexType indexType)
+		{
+			return (indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+		}
 
-			size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-			size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-			indexCount = static_cast<uint32_t>(indexBuffer.size());
+		// Removes duplicate vertices and reorders triangles and vertices for GPU cache efficiency
+		// Runs before the model is baked, so baked files store the optimized geometry
+		void Model::optimizeGeometry(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, std::string name)
+		{
+			// Triangles are only reordered within a primitive, as primitives are drawn separately
+			std::vector<MeshOptimizer::Range> ranges;
+			for (auto node : linearNodes) {
+				if (node->mesh) {
+					for (Primitive* primitive : node->mesh->primitives) {
+						if (!primitive->hasIndices) {
+							// Keeps the source triangle order of non-indexed primitives, their vertices are still deduplicated and remapped
+							continue;
+						}
+						ranges.push_back({ primitive->firstIndex, primitive->indexCount });
+					}
+				}
+			}
+			// Models with only non-indexed primitives have no ranges, but still get their vertices deduplicated and reordered
+			if (indexBuffer.empty()) {
+				return;
+			}
+			uint32_t vertexCount = static_cast<uint32_t>(vertexBuffer.size());
+			MeshOptimizer::Statistics statistics = MeshOptimizer::optimize(vertexBuffer.data(), vertexCount, sizeof(Vertex), indexBuffer, ranges);
+			vertexBuffer.resize(vertexCount);
 
-			assert(vertexBufferSize > 0);
+			std::stringstream message;
+			message << std::fixed << std::setprecision(3);
+			message << "Optimized mesh " << name << ": " << statistics.vertexCountBefore << " -> " << statistics.vertexCountAfter << " vertices, ACMR " << statistics.acmrBefore << " -> " << statistics.acmrAfter << ", " << (vertexCount < 65536 ? 16 : 32) << " bit indices\n";
+			std::clog << message.str();
+		}
 
-			Buffer vertexStaging, indexStaging;
+		// Converts vertices to the compact layout and stores the position dequantization parameters
+		std::vector<Model::CompactVertex> Model::compressVertices(const std::vector<Vertex>& vertexBuffer)
+		{
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+			for (const Vertex& vertex : vertexBuffer) {
+				min = glm::min(min, vertex.pos);
+				max = glm::max(max, vertex.pos);
+			}
+			// A single extent for all axes keeps the dequantization parameters in one vec4
+			const glm::vec3 center = (min + max) * 0.5f;
+			const glm::vec3 halfExtents = (max - min) * 0.5f;
+			float extent = std::max(halfExtents.x, std::max(halfExtents.y, halfExtents.z));
+			if (extent <= 0.0f) {
+				extent = 1.0f;
+			}
+			positionCenterExtent = glm::vec4(center, extent);
+
+			auto snorm16 = [](float value) {
+				return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+			};
 
-			// Create staging buffers
-			// Vertex data
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_MEMORY_USAGE_CPU_ONLY,
-				&vertexStaging,
-				vertexBufferSize,
-				vertexBuffer.data()));
-			// Index data
-			if (indexBufferSize > 0) {
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VMA_MEMORY_USAGE_CPU_ONLY,
-					&indexStaging,
-					indexBufferSize,
-					indexBuffer.data()));
+			std::vector<CompactVertex> compactVertexBuffer(vertexBuffer.size());
+			for (size_t i = 0; i < vertexBuffer.size(); i++) {
+				const Vertex& vertex = vertexBuffer[i];
+				CompactVertex& compactVertex = compactVertexBuffer[i];
+				const glm::vec3 pos = (vertex.pos - center) / extent;
+				compactVertex.pos[0] = snorm16(pos.x);
+				compactVertex.pos[1] = snorm16(pos.y);
+				compactVertex.pos[2] = snorm16(pos.z);
+				compactVertex.pos[3] = 0;
+				// Octahedral normal encoding, missing normals are stored as +z
+				glm::vec3 n = vertex.normal;
+				const float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+				n = (length > 0.0f && !std::isnan(length)) ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+				glm::vec2 octahedral = glm::vec2(n.x, n.y);
+				if (n.z < 0.0f) {
+					octahedral = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+				}
+				compactVertex.normal[0] = snorm16(octahedral.x);
+				compactVertex.normal[1] = snorm16(octahedral.y);
+				compactVertex.uv[0] = glm::packHalf1x16(vertex.uv0.x);
+				compactVertex.uv[1] = glm::packHalf1x16(vertex.uv0.y);
+			}
+			return compactVertexBuffer;
+		}
+
+		void Model::pushVertexConstants(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+		{
+			if (vertexFormat == VERTEX_FORMAT_COMPACT) {
+				PushConstBlockVertex pushConstBlockVertex{ positionCenterExtent };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, PUSH_CONSTANT_VERTEX_OFFSET, sizeof(PushConstBlockVertex), &pushConstBlockVertex);
+			}
+		}
+
+		// Suballocates the geometry from the shared mesh buffer if possible, creates buffers for this model otherwise
+		// Vertex and index data have to be in the model's vertex format and index type
+		// The shared mesh buffer only holds compact vertices with 16 bit indices
+		void Model::createGeometryBuffers(const void* vertexData, uint32_t vertexCount, const void* indexData, uint32_t indexCount)
+		{
+			const size_t vertexBufferSize = (size_t)vertexCount * getVertexStride(vertexFormat);
+			const size_t indexBufferSize = (size_t)indexCount * getIndexSize(indexType);
+			this->vertexCount = vertexCount;
+			this->indexCount = indexCount;
+
+			const bool shareable = meshBuffer && (vertexFormat == VERTEX_FORMAT_COMPACT) && (indexType == meshBuffer->indexType);
+			sharedGeometry = shareable && meshBuffer->allocate(vertexCount, indexCount, vertexOffset, firstIndex);
+			if (sharedGeometry) {
+				device->uploadManager->uploadBuffer(meshBuffer->vertices.buffer, vertexData, vertexBufferSize, (VkDeviceSize)vertexOffset * sizeof(CompactVertex));
+				if (indexBufferSize > 0) {
+					device->uploadManager->uploadBuffer(meshBuffer->indices.buffer, indexData, indexBufferSize, (VkDeviceSize)firstIndex * getIndexSize(indexType));
+				}
+				return;
+			}
+			if (shareable) {
+				std::cerr << "Shared mesh buffer is full, model uses separate buffers\n";
 			}
+			vertexOffset = 0;
+			firstIndex = 0;
 
 			// Create device local buffers
 			// Vertex buffer
@@ -1081,115 +1596,73 @@ namespace vkglTF
 				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				VMA_MEMORY_USAGE_GPU_ONLY,
 				&vertices,
-				vertexBufferSize));
+				vertexBufferSize,
+				nullptr,
+				MemoryCategory::Geometry));
 			// Index buffer
 			if (indexBufferSize > 0) {
 				VK_CHECK_RESULT(device->createBuffer(
 					VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 					VMA_MEMORY_USAGE_GPU_ONLY,
 					&indices,
-					indexBufferSize));
+					indexBufferSize,
+					nullptr,
+					MemoryCategory::Geometry));
 			}
 
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion = {};
-
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
+			// Copy via the batched staging arena
+			device->uploadManager->uploadBuffer(vertices.buffer, vertexData, vertexBufferSize);
 			if (indexBufferSize > 0) {
-				copyRegion.size = indexBufferSize;
-				vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+				device->uploadManager->uploadBuffer(indices.buffer, indexData, indexBufferSize);
 			}
-
-			device->flushCommandBuffer(copyCmd, transferQueue, true);
-
-			vkDestroyBuffer(device->handle, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->handle, vertexStaging.memory, nullptr);
-			if (indexBufferSize > 0) {
-				vkDestroyBuffer(device->handle, indexStaging.buffer, nullptr);
-				vkFreeMemory(device->handle, indexStaging.memory, nullptr);
-			}
-
-			getSceneDimensions();
 		}
 
-		void Model::drawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance)
+		void Model::drawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance, uint32_t instanceCount)
 		{
 			if (node->mesh) {
 				for (Primitive* primitive : node->mesh->primitives) {
 
-					// Pass material parameters as push constants
-					PushConstBlockMaterial pushConstBlockMaterial{};
-					pushConstBlockMaterial.emissiveFactor = primitive->material.emissiveFactor;
-					// To save push constant space, availabilty and texture coordiante set are combined
-					// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
-					pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					pushConstBlockMaterial.normalTextureSet = primitive->material.normalTexture != nullptr ? primitive->material.texCoordSets.normal : -1;
-					pushConstBlockMaterial.occlusionTextureSet = primitive->material.occlusionTexture != nullptr ? primitive->material.texCoordSets.occlusion : -1;
-					pushConstBlockMaterial.emissiveTextureSet = primitive->material.emissiveTexture != nullptr ? primitive->material.texCoordSets.emissive : -1;
-					pushConstBlockMaterial.alphaMask = static_cast<float>(primitive->material.alphaMode == vkglTF::Material::ALPHAMODE_MASK);
-					pushConstBlockMaterial.alphaMaskCutoff = primitive->material.alphaCutoff;
-
-					// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
-
-					if (primitive->material.pbrWorkflows.metallicRoughness) {
-						// Metallic roughness workflow
-						pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
-						pushConstBlockMaterial.baseColorFactor = primitive->material.baseColorFactor;
-						pushConstBlockMaterial.metallicFactor = primitive->material.metallicFactor;
-						pushConstBlockMaterial.roughnessFactor = primitive->material.roughnessFactor;
-						pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.metallicRoughnessTexture != nullptr ? primitive->material.texCoordSets.metallicRoughness : -1;
-						pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					}
-
-					if (primitive->material.pbrWorkflows.specularGlossiness) {
-						// Specular glossiness workflow
-						pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_SPECULAR_GLOSINESS);
-						pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.extension.specularGlossinessTexture != nullptr ? primitive->material.texCoordSets.specularGlossiness : -1;
-						pushConstBlockMaterial.colorTextureSet = primitive->material.extension.diffuseTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-						pushConstBlockMaterial.diffuseFactor = primitive->material.extension.diffuseFactor;
-						pushConstBlockMaterial.specularFactor = glm::vec4(primitive->material.extension.specularFactor, 1.0f);
-					}
-
-					// @todo: Setter for material push constant offset, size, layout etc.
+					// Material parameters are precomputed in the shared material buffer, only the material's index is passed
+					PushConstBlockMaterial pushConstBlockMaterial{ primitive->material.index };
 					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstBlockMaterial), &pushConstBlockMaterial);
 
-					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, firstInstance);
+					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, firstIndex + primitive->firstIndex, vertexOffset, firstInstance);
 				}
 			}
 			for (auto& child : node->children) {
-				drawNode(child, commandBuffer, pipelineLayout);
+				drawNode(child, commandBuffer, pipelineLayout, firstInstance, instanceCount);
 			}
 		}
 
 		void Model::bindBuffers(VkCommandBuffer commandBuffer)
 		{
+			if (sharedGeometry) {
+				meshBuffer->bind(commandBuffer);
+				return;
+			}
 			const VkDeviceSize offsets[1] = { 0 };
 			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indexType);
 		}
 
-		void Model::drawNodes(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance)
+		// Models using the shared mesh buffer expect it to be bound already (see MeshBuffer::bind)
+		// Models with their own geometry buffers bind them and restore the shared binding afterwards
+		void Model::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance, uint32_t instanceCount)
 		{
-			for (auto& node : nodes) {
-				drawNode(node, commandBuffer, pipelineLayout, firstInstance);
+			if (!sharedGeometry) {
+				bindBuffers(commandBuffer);
 			}
-		}
-
-		void Model::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance)
-		{
-			const VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			pushVertexConstants(commandBuffer, pipelineLayout);
 			for (auto& node : nodes) {
-				drawNode(node, commandBuffer, pipelineLayout, firstInstance);
+				drawNode(node, commandBuffer, pipelineLayout, firstInstance, instanceCount);
+			}
+			// Restore the shared geometry binding for the following draws
+			if (!sharedGeometry && meshBuffer) {
+				meshBuffer->bind(commandBuffer);
 			}
 		}
 
-		void Model::drawNodeWithMaterial(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance)
+		void Model::drawNodeWithMaterial(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance, uint32_t instanceCount)
 		{
 			if (node->mesh) {
 				for (Primitive* primitive : node->mesh->primitives) {
@@ -1197,57 +1670,29 @@ namespace vkglTF
 					// @todo: Pass frist set
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &primitive->material.descriptorSet, 0, nullptr);
 
-					// Pass material parameters as push constants
-					PushConstBlockMaterial pushConstBlockMaterial{};
-					pushConstBlockMaterial.emissiveFactor = primitive->material.emissiveFactor;
-					// To save push constant space, availabilty and texture coordiante set are combined
-					// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
-					pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					pushConstBlockMaterial.normalTextureSet = primitive->material.normalTexture != nullptr ? primitive->material.texCoordSets.normal : -1;
-					pushConstBlockMaterial.occlusionTextureSet = primitive->material.occlusionTexture != nullptr ? primitive->material.texCoordSets.occlusion : -1;
-					pushConstBlockMaterial.emissiveTextureSet = primitive->material.emissiveTexture != nullptr ? primitive->material.texCoordSets.emissive : -1;
-					pushConstBlockMaterial.alphaMask = static_cast<float>(primitive->material.alphaMode == vkglTF::Material::ALPHAMODE_MASK);
-					pushConstBlockMaterial.alphaMaskCutoff = primitive->material.alphaCutoff;
-
-					// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
-
-					if (primitive->material.pbrWorkflows.metallicRoughness) {
-						// Metallic roughness workflow
-						pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
-						pushConstBlockMaterial.baseColorFactor = primitive->material.baseColorFactor;
-						pushConstBlockMaterial.metallicFactor = primitive->material.metallicFactor;
-						pushConstBlockMaterial.roughnessFactor = primitive->material.roughnessFactor;
-						pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.metallicRoughnessTexture != nullptr ? primitive->material.texCoordSets.metallicRoughness : -1;
-						pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					}
-
-					if (primitive->material.pbrWorkflows.specularGlossiness) {
-						// Specular glossiness workflow
-						pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_SPECULAR_GLOSINESS);
-						pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.extension.specularGlossinessTexture != nullptr ? primitive->material.texCoordSets.specularGlossiness : -1;
-						pushConstBlockMaterial.colorTextureSet = primitive->material.extension.diffuseTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-						pushConstBlockMaterial.diffuseFactor = primitive->material.extension.diffuseFactor;
-						pushConstBlockMaterial.specularFactor = glm::vec4(primitive->material.extension.specularFactor, 1.0f);
-					}
-
-					// @todo: Setter for material push constant offset, size, layout etc.
+					PushConstBlockMaterial pushConstBlockMaterial{ primitive->material.index };
 					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstBlockMaterial), &pushConstBlockMaterial);
 
-					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, firstInstance);
+					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, firstIndex + primitive->firstIndex, vertexOffset, firstInstance);
 				}
 			}
 			for (auto& child : node->children) {
-				drawNodeWithMaterial(child, commandBuffer, pipelineLayout);
+				drawNodeWithMaterial(child, commandBuffer, pipelineLayout, firstInstance, instanceCount);
 			}
 		}
 
-		void Model::drawWithMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance)
+		// Same as draw, but also binds each primitive's material textures to set 2 (e.g. for the gltf_pbr pipeline)
+		void Model::drawWithMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance, uint32_t instanceCount)
 		{
-			const VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			if (!sharedGeometry) {
+				bindBuffers(commandBuffer);
+			}
+			pushVertexConstants(commandBuffer, pipelineLayout);
 			for (auto& node : nodes) {
-				drawNodeWithMaterial(node, commandBuffer, pipelineLayout, firstInstance);
+				drawNodeWithMaterial(node, commandBuffer, pipelineLayout, firstInstance, instanceCount);
+			}
+			if (!sharedGeometry && meshBuffer) {
+				meshBuffer->bind(commandBuffer);
 			}
 		}
 
@@ -1305,35 +1750,46 @@ namespace vkglTF
 			}
 			Animation& animation = animations[index];
 
-			bool updated = false;
 			for (auto& channel : animation.channels) {
 				vkglTF::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
 				if (sampler.inputs.size() > sampler.outputsVec4.size()) {
 					continue;
 				}
 
-				for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-					if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-						float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-						if (u <= 1.0f) {
-							switch (channel.path) {
-							case vkglTF::AnimationChannel::PathType::TRANSLATION:
-								sampler.translate(i, time, channel.node);
-								break;
-							case vkglTF::AnimationChannel::PathType::SCALE:
-								sampler.scale(i, time, channel.node);
-								break;
-							case vkglTF::AnimationChannel::PathType::ROTATION:
-								sampler.rotate(i, time, channel.node);
-							}
-							updated = true;
-						}
+				size_t i;
+				if (sampler.findKeyframe(time, channel.keyframeCursor, i)) {
+					switch (channel.path) {
+					case vkglTF::AnimationChannel::PathType::TRANSLATION:
+						sampler.translate(i, time, channel.node);
+						break;
+					case vkglTF::AnimationChannel::PathType::SCALE:
+						sampler.scale(i, time, channel.node);
+						break;
+					case vkglTF::AnimationChannel::PathType::ROTATION:
+						sampler.rotate(i, time, channel.node);
 					}
+					channel.node->setDirty();
 				}
 			}
-			if (updated) {
-				for (auto& node : nodes) {
-					node->update();
+			updateNodes();
+		}
+
+		// Updates the world matrices of all changed nodes and the uniform buffers of their meshes
+		void Model::updateNodes()
+		{
+			bool changed = false;
+			for (auto& node : nodes) {
+				changed |= node->updateWorldMatrix(false);
+			}
+			// Joints can be anywhere in the hierarchy, so skinned meshes are updated if any node changed
+			if (changed) {
+				for (auto& node : linearNodes) {
+					if (node->mesh && node->skin) {
+						node->update();
+						if (jointBuffer && node->skin->jointMatrices) {
+							jointBuffer->setDirty(node->skin->firstJoint, static_cast<uint32_t>(node->skin->joints.size()));
+						}
+					}
 				}
 			}
 		}
@@ -1366,17 +1822,49 @@ namespace vkglTF
 			return nodeFound;
 		}
 
+		// Flattens the material's parameters into the layout used by the shaders
+		ShaderMaterial Material::getShaderMaterial() const
+		{
+			ShaderMaterial shaderMaterial{};
+			shaderMaterial.emissiveFactor = emissiveFactor;
+			// To save space, availabilty and texture coordiante set are combined
+			// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
+			shaderMaterial.colorTextureSet = baseColorTexture != nullptr ? texCoordSets.baseColor : -1;
+			shaderMaterial.normalTextureSet = normalTexture != nullptr ? texCoordSets.normal : -1;
+			shaderMaterial.occlusionTextureSet = occlusionTexture != nullptr ? texCoordSets.occlusion : -1;
+			shaderMaterial.emissiveTextureSet = emissiveTexture != nullptr ? texCoordSets.emissive : -1;
+			shaderMaterial.alphaMask = static_cast<float>(alphaMode == vkglTF::Material::ALPHAMODE_MASK);
+			shaderMaterial.alphaMaskCutoff = alphaCutoff;
+
+			// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
+
+			if (pbrWorkflows.metallicRoughness) {
+				// Metallic roughness workflow
+				shaderMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
+				shaderMaterial.baseColorFactor = baseColorFactor;
+				shaderMaterial.metallicFactor = metallicFactor;
+				shaderMaterial.roughnessFactor = roughnessFactor;
+				shaderMaterial.PhysicalDescriptorTextureSet = metallicRoughnessTexture != nullptr ? texCoordSets.metallicRoughness : -1;
+				shaderMaterial.colorTextureSet = baseColorTexture != nullptr ? texCoordSets.baseColor : -1;
+			}
+
+			if (pbrWorkflows.specularGlossiness) {
+				// Specular glossiness workflow
+				shaderMaterial.workflow = static_cast<float>(PBR_WORKFLOW_SPECULAR_GLOSINESS);
+				shaderMaterial.PhysicalDescriptorTextureSet = extension.specularGlossinessTexture != nullptr ? texCoordSets.specularGlossiness : -1;
+				shaderMaterial.colorTextureSet = extension.diffuseTexture != nullptr ? texCoordSets.baseColor : -1;
+				shaderMaterial.diffuseFactor = extension.diffuseFactor;
+				shaderMaterial.specularFactor = glm::vec4(extension.specularFactor, 1.0f);
+			}
+			return shaderMaterial;
+		}
+
 		void Material::createDescriptorSet()
 		{
-			assert(materialDescriptorPool != VK_NULL_HANDLE);
+			assert(descriptorAllocator != nullptr);
 			assert(materialDescriptorSetLayout != VK_NULL_HANDLE);
 
-			VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-			descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			descriptorSetAllocInfo.descriptorPool = materialDescriptorPool;
-			descriptorSetAllocInfo.pSetLayouts = &materialDescriptorSetLayout;
-			descriptorSetAllocInfo.descriptorSetCount = 1;
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->handle, &descriptorSetAllocInfo, &descriptorSet));
+			descriptorSet = descriptorAllocator->allocate(materialDescriptorSetLayout);
 
 			std::vector<VkDescriptorImageInfo> imageDescriptors = {
 				baseColorTexture ? baseColorTexture->descriptor : emptyTextureImageDescriptor,
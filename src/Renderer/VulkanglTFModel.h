@@ -14,6 +14,13 @@
 #include "vulkan/vulkan.h"
 #include "Buffer.h"
 #include "Device.h"
+#include "MappedFile.h"
+#include "MeshBuffer.h"
+#include "MeshOptimizer.h"
+#include "MaterialBuffer.h"
+#include "JointBuffer.h"
+#include "DescriptorAllocator.h"
+#include "TextureCache.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -21,6 +28,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <glm/gtc/packing.hpp>
 
 // ERROR is already defined in wingdi.h and collides with a define in the Draco headers
 #if defined(_WIN32) && defined(ERROR) && defined(TINYGLTF_ENABLE_DRACO) 
@@ -36,19 +44,18 @@
 #include <android/asset_manager.h>
 #endif
 
-// Changing this value here also requires changing it in the vertex shader
-#define MAX_NUM_JOINTS 128u
-
 namespace vkglTF
 {
 	extern VkDescriptorSetLayout materialDescriptorSetLayout;
-	// @todo: One pool per model
-	extern VkDescriptorPool materialDescriptorPool;
+	// Set by the renderer, material descriptor sets are allocated from this and returned when their model is destroyed
+	extern DescriptorAllocator* descriptorAllocator;
 	extern VkDescriptorImageInfo emptyTextureImageDescriptor;
 
 	enum PBRWorkflows { PBR_WORKFLOW_METALLIC_ROUGHNESS = 0, PBR_WORKFLOW_SPECULAR_GLOSINESS = 1 };
 
-	struct PushConstBlockMaterial {
+	// Shader parameters of a material, precomputed at load time and stored in the shared material buffer
+	// Matches the std430 layout of the Material struct in includes/material_buffer.glsl
+	struct ShaderMaterial {
 		glm::vec4 baseColorFactor;
 		glm::vec4 emissiveFactor;
 		glm::vec4 diffuseFactor;
@@ -63,8 +70,22 @@ namespace vkglTF
 		float roughnessFactor;
 		float alphaMask;
 		float alphaMaskCutoff;
+		float padding[2];
+	};
+	static_assert(sizeof(ShaderMaterial) == 112, "Shader material size does not match the std430 array stride");
+
+	// Index of the material used by a draw into the shared material buffer, pushed to the fragment stage
+	struct PushConstBlockMaterial {
+		uint32_t materialIndex;
 	};
 
+	// Dequantization parameters for compact vertices, pushed to the vertex stage behind the material index
+	struct PushConstBlockVertex {
+		glm::vec4 positionCenterExtent;
+	};
+	const uint32_t PUSH_CONSTANT_VERTEX_OFFSET = 16;
+	static_assert(sizeof(PushConstBlockMaterial) <= PUSH_CONSTANT_VERTEX_OFFSET, "Material push constants overlap vertex push constants");
+
 	struct Node;
 
 	struct BoundingBox {
@@ -95,6 +116,8 @@ namespace vkglTF
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		// Size of deviceMemory as reported to the memory tracker
+		VkDeviceSize memorySize = 0;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -104,8 +127,7 @@ namespace vkglTF
 		void updateDescriptor();
 		void destroy();
 		/*
-			Load a texture from a glTF image (stored as vector of chars loaded via stb_image)
-			Also generates the mip chain as glTF images are stored as jpg or png without any mips
+			Load a texture from a glTF image (converted to KTX with a full mip chain by the texture cache)
 		*/
 		void fromglTfImage(tinygltf::Image& gltfimage, TextureSampler textureSampler, Device* device, VkQueue copyQueue);
 	};
@@ -122,11 +144,11 @@ namespace vkglTF
 		float roughnessFactor = 1.0f;
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
 		glm::vec4 emissiveFactor = glm::vec4(1.0f);
-		vkglTF::Texture* baseColorTexture;
-		vkglTF::Texture* metallicRoughnessTexture;
-		vkglTF::Texture* normalTexture;
-		vkglTF::Texture* occlusionTexture;
-		vkglTF::Texture* emissiveTexture;
+		vkglTF::Texture* baseColorTexture = nullptr;
+		vkglTF::Texture* metallicRoughnessTexture = nullptr;
+		vkglTF::Texture* normalTexture = nullptr;
+		vkglTF::Texture* occlusionTexture = nullptr;
+		vkglTF::Texture* emissiveTexture = nullptr;
 		struct TexCoordSets {
 			uint8_t baseColor = 0;
 			uint8_t metallicRoughness = 0;
@@ -136,8 +158,8 @@ namespace vkglTF
 			uint8_t emissive = 0;
 		} texCoordSets;
 		struct Extension {
-			vkglTF::Texture* specularGlossinessTexture;
-			vkglTF::Texture* diffuseTexture;
+			vkglTF::Texture* specularGlossinessTexture = nullptr;
+			vkglTF::Texture* diffuseTexture = nullptr;
 			glm::vec4 diffuseFactor = glm::vec4(1.0f);
 			glm::vec3 specularFactor = glm::vec3(0.0f);
 		} extension;
@@ -146,6 +168,9 @@ namespace vkglTF
 			bool specularGlossiness = false;
 		} pbrWorkflows;
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Index into the shared material buffer
+		uint32_t index = 0;
+		ShaderMaterial getShaderMaterial() const;
 		void createDescriptorSet();
 	};
 
@@ -180,10 +205,11 @@ namespace vkglTF
 			VkDescriptorSet descriptorSet;
 		} uniformBuffer;
 
+		// Joint matrices of skinned meshes are stored in the shared joint buffer starting at firstJoint
 		struct UniformBlock {
 			glm::mat4 matrix;
-			glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
-			float jointcount{ 0 };
+			uint32_t firstJoint{ 0 };
+			uint32_t jointCount{ 0 };
 		} uniformBlock;
 
 		Mesh(Device* device, glm::mat4 matrix);
@@ -199,6 +225,9 @@ namespace vkglTF
 		Node* skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node*> joints;
+		// Range of the shared joint buffer holding this skin's joint matrices
+		uint32_t firstJoint = 0;
+		glm::mat4* jointMatrices = nullptr;
 	};
 
 	/*
@@ -218,9 +247,17 @@ namespace vkglTF
 		glm::quat rotation{};
 		BoundingBox bvh;
 		BoundingBox aabb;
+		// Cached world matrix, recalculated on demand once the node or one of its parents changed
+		glm::mat4 worldMatrix{ 1.0f };
+		bool worldMatrixValid = false;
+		// Set if the mesh's uniform buffer needs to be updated by Model::updateNodes
+		bool dirty = true;
 
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
+		void setDirty();
+		void invalidateWorldMatrix();
+		bool updateWorldMatrix(bool parentChanged);
 		void update();
 		~Node();
 	};
@@ -233,6 +270,8 @@ namespace vkglTF
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
+		// Keyframe interval used by the last update of this channel
+		size_t keyframeCursor = 0;
 	};
 
 	/*
@@ -248,6 +287,7 @@ namespace vkglTF
 		// Details on how this works can be found in the specs: 
 		// https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#appendix-c-spline-interpolation
 		glm::vec4 cubicSplineInterpolation(size_t index, float time, uint32_t stride);
+		bool findKeyframe(float time, size_t& cursor, size_t& index) const;
 		void translate(size_t index, float time, vkglTF::Node* node);
 		void scale(size_t index, float time, vkglTF::Node* node);
 		void rotate(size_t index, float time, vkglTF::Node* node);
@@ -280,9 +320,34 @@ namespace vkglTF
 			glm::vec4 weight0;
 		};
 
+		// Vertex layout for static meshes without skinning and a second uv set
+		// Positions are quantized relative to the model's bounding box, normals are octahedral encoded and uvs are half floats
+		struct CompactVertex {
+			int16_t pos[4];
+			int16_t normal[2];
+			uint16_t uv[2];
+		};
+
+		enum VertexFormat { VERTEX_FORMAT_FULL = 0, VERTEX_FORMAT_COMPACT = 1 };
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL;
+		// Bounding box center in xyz and half extent of its largest axis in w, used to dequantize compact positions
+		glm::vec4 positionCenterExtent = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
 		Buffer vertices;
 		Buffer indices;
+		uint32_t vertexCount = 0;
 		uint32_t indexCount;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+		// If set before loading, geometry is suballocated from this shared buffer instead of the model's own buffers
+		MeshBuffer* meshBuffer = nullptr;
+		bool sharedGeometry = false;
+		uint32_t vertexOffset = 0;
+		uint32_t firstIndex = 0;
+		// Material parameters are stored in this shared buffer, has to be set before loading
+		MaterialBuffer* materialBuffer = nullptr;
+		// Joint matrices of skins are stored in this shared buffer, has to be set before loading
+		JointBuffer* jointBuffer = nullptr;
 
 		glm::mat4 aabb;
 
@@ -311,16 +376,34 @@ namespace vkglTF
 		void loadTextureSamplers(tinygltf::Model& gltfModel);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
-		void loadFromFile(std::string filename, Device* device, VkQueue transferQueue, float scale = 1.0f);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0);
+		static bool loadglTFFile(std::string filename, tinygltf::Model& gltfModel, TextureCache::Format textureFormat = TextureCache::FORMAT_RGBA8);
+		// glTF images are converted to KTX with pre-generated mips once and cached in this directory next to the model
+		static std::string getTextureCacheDirectory(std::string filename);
+		void loadFromglTFModel(tinygltf::Model& gltfModel, Device* device, VkQueue transferQueue, float scale = 1.0f, std::string sourceFilename = "", bool bake = false);
+		// Baked models are a preprocessed binary version of a glTF file that can be mapped and uploaded without any parsing
+		static std::string getBakedFilename(std::string filename);
+		static bool isBakeable(const tinygltf::Model& gltfModel);
+		static bool openBakedFile(std::string filename, std::string sourceFilename, MappedFile& file);
+		void loadFromBakedFile(const MappedFile& file, Device* device, VkQueue transferQueue);
+		bool writeBakedFile(std::string filename, std::string sourceFilename, const std::vector<std::string>& dependencies, const void* indexData, uint32_t indexCount, const void* vertexData, uint32_t vertexCount);
+		void loadFromFile(std::string filename, Device* device, VkQueue transferQueue, float scale = 1.0f, bool forceBake = false);
+		static VertexFormat selectVertexFormat(const tinygltf::Model& gltfModel);
+		static uint32_t getVertexStride(VertexFormat vertexFormat);
+		static uint32_t getIndexSize(VkIndexType indexType);
+		void uploadMaterials();
+		void optimizeGeometry(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, std::string name);
+		std::vector<CompactVertex> compressVertices(const std::vector<Vertex>& vertexBuffer);
+		void pushVertexConstants(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+		void createGeometryBuffers(const void* vertexData, uint32_t vertexCount, const void* indexData, uint32_t indexCount);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNodes(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0);
-		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0);
-		void drawNodeWithMaterial(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0);
-		void drawWithMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0);
+		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
+		void drawNodeWithMaterial(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
+		void drawWithMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
 		void calculateBoundingBox(Node* node, Node* parent);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		void updateNodes();
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 	};
@@ -30,16 +30,6 @@ LightSource Servant::getLightSource()
     return lightSource;
 }
 
-void Servant::prepareGPUResources()
-{
-    VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &ubo, sizeof(glm::mat4)));
-    descriptorSet = new DescriptorSet(renderer->device->handle);
-    descriptorSet->setPool(renderer->descriptorPool);
-    descriptorSet->addLayout(renderer->getDescriptorSetLayout("single_ubo"));
-    descriptorSet->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &ubo.descriptor);
-    descriptorSet->create();
-}
-
 void Servant::updateGPUResources()
 {
     glm::mat4 mat = glm::translate(glm::mat4(1.0f), position);
@@ -50,17 +40,23 @@ void Servant::updateGPUResources()
     if (state == ServantState::Disappearing) {
         mat = glm::scale(mat, glm::vec3(1.0f - stateTimer));
     }
-    ubo.copyTo(&mat, sizeof(mat));
+    transform = mat;
 }
 
 void Servant::setModel(std::string name)
 {
     model = assetManager->getModel(name);
     assert(model);
+    renderer->checkModelVertexFormat("servant", name);
     size.x = model->dimensions.max.x - model->dimensions.min.x;
     size.y = model->dimensions.max.z - model->dimensions.min.z;
 }
 
+vkglTF::Model* Servant::getModel()
+{
+    return model;
+}
+
 void Servant::changeDirection()
 {
     direction.x = randomFloat(2.0f) - 1.0f;
@@ -151,17 +147,6 @@ void Servant::update(float dT)
     updateGPUResources();
 }
 
-void Servant::draw(CommandBuffer* cb)
-{
-    assert(model);
-    //@todo: Distinct pipeline
-    if (alive()) {
-        cb->bindPipeline(renderer->getPipeline("player"));
-        cb->bindDescriptorSets(renderer->getPipelineLayout("split_ubo"), { renderer->descriptorSets.camera, descriptorSet }, 0);
-        model->draw(cb->handle, renderer->getPipelineLayout("split_ubo")->handle);
-    }
-}
-
 void Servant::spawn(glm::vec2 spawnPosition)
 {
     state = ServantState::Appearing;
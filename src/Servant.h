@@ -24,8 +24,6 @@ enum class ServantState {
 class Servant: public RenderObject
 {
 private:
-	Buffer ubo;
-	DescriptorSet* descriptorSet;
 	vkglTF::Model* model;
 	void changeDirection();
 public:
@@ -42,13 +40,14 @@ public:
 	float directionChangeTimer = 1.0f;
 	float stateTimer = 0.0f;
 	ServantState state = ServantState::Appearing;
+	// Model matrix including the appear/disappear scale, servants are drawn instanced (see Game::drawServants)
+	glm::mat4 transform = glm::mat4(1.0f);
 	Servant();
 	LightSource getLightSource();
-	void prepareGPUResources();
 	void updateGPUResources();
 	void setModel(std::string name);
+	vkglTF::Model* getModel();
 	void update(float dT);
-	void draw(CommandBuffer* cb);
 	void spawn(glm::vec2 spawnPosition);
 	bool hitTest(glm::vec3 pos);
 	bool alive();
@@ -17,7 +17,11 @@ TarotDeck::TarotDeck()
 
 TarotDeck::~TarotDeck()
 {
-	ubo.destroy();
+	renderer->transformBuffer->free(transformSlot);
+	// The first two sets are the renderer's camera and transform sets
+	for (size_t i = 2; i < descriptorSets.size(); i++) {
+		delete descriptorSets[i];
+	}
 }
 
 void TarotDeck::setState(TarotDeckState newState)
@@ -44,18 +48,16 @@ void TarotDeck::setState(TarotDeckState newState)
 
 void TarotDeck::prepareGPUResources()
 {
-	VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &ubo, sizeof(glm::mat4)));
+	transformSlot = renderer->transformBuffer->allocate();
+	pipelineLayout = renderer->getPipelineLayout("split_ubo_single_image");
+	pipeline = renderer->getPipeline("tarot_card");
 	descriptorSets.resize(3);
 	descriptorSets[0] = renderer->descriptorSets.camera;
-	descriptorSets[1] = new DescriptorSet(renderer->device->handle);
-	descriptorSets[1]->setPool(renderer->descriptorPool);
-	descriptorSets[1]->addLayout(renderer->getDescriptorSetLayout("single_ubo"));
-	descriptorSets[1]->addDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &ubo.descriptor);
-	descriptorSets[1]->create();
+	descriptorSets[1] = renderer->descriptorSets.transforms;
 	Texture* texture = assetManager->getTexture("tarot_deck_b");
 	assert(texture);
 	descriptorSets[2] = new DescriptorSet(renderer->device->handle);
-	descriptorSets[2]->setPool(renderer->descriptorPool);
+	descriptorSets[2]->setAllocator(renderer->descriptorAllocator);
 	descriptorSets[2]->addLayout(renderer->getDescriptorSetLayout("single_image"));
 	descriptorSets[2]->addDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &texture->descriptor);
 	descriptorSets[2]->create();
@@ -68,13 +70,14 @@ void TarotDeck::updateGPUResources()
 	mat = glm::rotate(mat, rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
 	mat = glm::rotate(mat, rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
 	mat = glm::scale(mat, scale);
-	ubo.copyTo(&mat, sizeof(mat));
+	renderer->transformBuffer->set(transformSlot, mat);
 }
 
 void TarotDeck::setModel(std::string name)
 {
 	model = assetManager->getModel(name);
 	assert(model);
+	renderer->checkModelVertexFormat("tarot_card", name);
 	size.x = model->dimensions.max.x - model->dimensions.min.x;
 	size.y = model->dimensions.max.z - model->dimensions.min.z;
 }
@@ -139,9 +142,9 @@ void TarotDeck::update(float dT, glm::vec3 playerPos)
 void TarotDeck::draw(CommandBuffer* cb)
 {
 	if (state != TarotDeckState::Hidden) {
-		cb->bindPipeline(renderer->getPipeline("tarot_card"));
-		cb->bindDescriptorSets(renderer->getPipelineLayout("split_ubo_single_image"), descriptorSets, 0);
-		model->draw(cb->handle, renderer->getPipelineLayout("split_ubo")->handle);
+		cb->bindPipeline(pipeline);
+		cb->bindDescriptorSets(pipelineLayout, descriptorSets, 0, { renderer->transformBuffer->getOffset(transformSlot) });
+		model->draw(cb->handle, pipelineLayout->handle);
 	}
 }
 
@@ -24,11 +24,14 @@ class TarotDeck: public RenderObject
 {
 private:
     vkglTF::Model* model;
+    PipelineLayout* pipelineLayout = nullptr;
+    Pipeline* pipeline = nullptr;
 public:
     TarotDeckState state = TarotDeckState::Hidden;
     float stateTimer;
     float activationTimer;
-    Buffer ubo;
+    // Slot of the model matrix in the renderer's transform buffer
+    uint32_t transformSlot = 0;
     std::vector<DescriptorSet*> descriptorSets;
     glm::vec3 position;
     glm::vec3 rotation;
@@ -0,0 +1,89 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+// Runs the game loop for a fixed number of frames and fails if any frame after the warmup allocates from the heap
+// Renders the same frames as the game, so this needs a Vulkan capable device and a display
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <cstdlib>
+
+#include <SDL.h>
+
+#include "../Renderer/AssetManager.h"
+#include "../GameLoop.h"
+#include "../AllocationTracker.h"
+
+int main(int argc, char* argv[])
+{
+	const uint32_t warmupFrameCount = 120;
+	const uint32_t testFrameCount = 600;
+
+	if (!AllocationTracker::available()) {
+		std::cerr << "The allocation test has to be built with TRACK_ALLOCATIONS defined" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	SDL_SetMainReady();
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {
+		std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
+		return EXIT_FAILURE;
+	}
+	for (int32_t i = 0; i < argc; i++) {
+		VulkanRenderer::args.push_back(argv[i]);
+	}
+
+	assetManager = new AssetManager();
+	renderer = new VulkanRenderer();
+	init();
+	if (!loadAssets()) {
+		std::cerr << "Window was closed while loading" << std::endl;
+		delete assetManager;
+		delete renderer;
+		return EXIT_FAILURE;
+	}
+	prepareGPUResources();
+
+	uint32_t allocatingFrameCount = 0;
+	bool completed = true;
+	// One frame more than tested, as the counters of a frame are read after the next one has run
+	for (uint32_t frame = 0; frame <= warmupFrameCount + testFrameCount; frame++) {
+		if (!runFrame()) {
+			completed = false;
+			break;
+		}
+		// The tracker's last frame counters are those of the frame before the one that just ran
+		if (frame <= warmupFrameCount) {
+			continue;
+		}
+		const AllocationTracker::Counters counters = AllocationTracker::getLastFrame();
+		if (counters.allocations == 0) {
+			continue;
+		}
+		allocatingFrameCount++;
+		// Only report the first frames, the offending zone is usually the same every frame
+		if (allocatingFrameCount <= 10) {
+			std::cerr << "Frame " << frame - 1 << " did " << counters.allocations << " heap allocations (" << counters.bytes << " bytes)" << std::endl;
+			for (uint32_t i = 0; i < AllocationTracker::getZoneCount(); i++) {
+				const AllocationTracker::Counters zone = AllocationTracker::getZoneLastFrame(i);
+				if (zone.allocations > 0) {
+					std::cerr << "  " << AllocationTracker::getZoneName(i) << ": " << zone.allocations << " (" << zone.bytes << " bytes)" << std::endl;
+				}
+			}
+		}
+	}
+	shutdown();
+
+	if (!completed) {
+		std::cerr << "Window was closed before all frames were rendered" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::clog << allocatingFrameCount << " of " << testFrameCount << " frames after warmup did heap allocations" << std::endl;
+	return (allocatingFrameCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,7 +20,7 @@ namespace UI
 		is >> json;
 		is.close();
 		for (auto& charinfo : json["chars"]) {
-			FontCharInfo& ci = charInfo[charinfo["id"]];
+			FontCharInfo& ci = glyphs[charinfo["id"].get<uint32_t>()];
 			ci.x = charinfo["x"];
 			ci.y = charinfo["y"];
 			ci.width = charinfo["width"];
@@ -32,6 +32,69 @@ namespace UI
 		lineHeight = json["common"]["lineHeight"];
 		texture = new Texture2D();
 		texture->loadFromFile(assetManager->assetPath + "fonts/" + fontname + ".ktx", device, transferQueue);
+		// Texture coordinates are normalized once, so layouts don't need to divide by the texture size for every glyph
+		const glm::vec2 textureSize = glm::vec2((float)getWidth(), (float)getHeight());
+		for (auto& glyph : glyphs) {
+			FontCharInfo& ci = glyph.second;
+			ci.uvMin = glm::vec2(ci.x, ci.y) / textureSize;
+			ci.uvMax = glm::vec2(ci.x + ci.width, ci.y + ci.height) / textureSize;
+		}
+	}
+
+	// Returns the glyph for a codepoint, falls back to '?' for codepoints not contained in the font
+	const FontCharInfo* Font::getGlyph(uint32_t codepoint)
+	{
+		auto it = glyphs.find(codepoint);
+		if (it == glyphs.end()) {
+			it = glyphs.find('?');
+			if (it == glyphs.end()) {
+				return nullptr;
+			}
+		}
+		return &it->second;
+	}
+
+	// Decodes the UTF-8 sequence at pos and advances pos past it, malformed sequences return the replacement character
+	// Overlong encodings, surrogates and codepoints above U+10FFFF are malformed too
+	uint32_t Font::nextCodepoint(const std::string& text, size_t& pos)
+	{
+		const uint32_t replacementCharacter = 0xFFFD;
+		const unsigned char lead = static_cast<unsigned char>(text[pos++]);
+		if (lead < 0x80) {
+			return lead;
+		}
+		uint32_t codepoint;
+		uint32_t continuationCount;
+		// Smallest codepoint that needs a sequence of this length
+		uint32_t minCodepoint;
+		if ((lead & 0xE0) == 0xC0) {
+			codepoint = lead & 0x1F;
+			continuationCount = 1;
+			minCodepoint = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0) {
+			codepoint = lead & 0x0F;
+			continuationCount = 2;
+			minCodepoint = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0) {
+			codepoint = lead & 0x07;
+			continuationCount = 3;
+			minCodepoint = 0x10000;
+		}
+		else {
+			return replacementCharacter;
+		}
+		for (uint32_t i = 0; i < continuationCount; i++) {
+			if ((pos >= text.size()) || ((static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80)) {
+				return replacementCharacter;
+			}
+			codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+		}
+		if ((codepoint < minCodepoint) || ((codepoint >= 0xD800) && (codepoint <= 0xDFFF)) || (codepoint > 0x10FFFF)) {
+			return replacementCharacter;
+		}
+		return codepoint;
 	}
 
 	uint32_t Font::getWidth()
@@ -7,8 +7,9 @@
 #pragma once
 
 #include <string>
-#include <array>
+#include <unordered_map>
 #include <stdio.h>
+#include <glm/glm.hpp>
 #include "json.hpp"
 #include "../Renderer/AssetManager.h"
 #include "../Renderer/Device.h"
@@ -25,17 +26,23 @@ namespace UI
         float xoffset;
         float yoffset;
         float xadvance;
+        // Normalized texture coordinates of the glyph's top left and bottom right corners
+        glm::vec2 uvMin;
+        glm::vec2 uvMax;
     };
 
     class Font
     {
     public:
         std::string name;
-        std::array<FontCharInfo, 255> charInfo;
+        // Glyphs by unicode codepoint
+        std::unordered_map<uint32_t, FontCharInfo> glyphs;
         float lineHeight;
         Texture2D* texture;
-        DescriptorSet* descriptorSet;
+        DescriptorSet* descriptorSet = nullptr;
         void load(std::string fontname, Device* device, VkQueue transferQueue);
+        const FontCharInfo* getGlyph(uint32_t codepoint);
+        static uint32_t nextCodepoint(const std::string& text, size_t& pos);
         uint32_t getWidth();
         uint32_t getHeight();
     };
@@ -13,12 +13,16 @@ namespace UI
 	GameUI::~GameUI()
 	{
 		for (auto& font : fonts) {
+			delete font.second->descriptorSet;
 			delete font.second;
 		}
 		for (auto& element : textElements) {
 			delete element.second;
 		}
 		vertexBuffer.destroy();
+		for (auto& buffer : retiredBuffers) {
+			buffer.destroy();
+		}
 	}
 
 	void GameUI::addFont(std::string name)
@@ -35,6 +39,11 @@ namespace UI
 		assert(font);
 	}
 
+	Font* GameUI::getFont()
+	{
+		return font;
+	}
+
 	void GameUI::addTextElement(std::string name, std::string text, glm::vec3 position, TextAlignment alignment, glm::vec4 color, bool visible)
 	{
 		TextElement* textElement = new TextElement;
@@ -55,115 +64,124 @@ namespace UI
 
 	void GameUI::prepareGPUResources()
 	{
+		pipeline = renderer->getPipeline("msdf");
+		pipelineLayout = renderer->getPipelineLayout("ui_text");
 		for (auto font : fonts) {
 			assert(font.second->texture);
 			font.second->descriptorSet = new DescriptorSet(renderer->device->handle);
-			font.second->descriptorSet->setPool(renderer->descriptorPool);
+			font.second->descriptorSet->setAllocator(renderer->descriptorAllocator);
 			font.second->descriptorSet->addLayout(renderer->getDescriptorSetLayout("ui_text"));
 			font.second->descriptorSet->addDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &font.second->texture->descriptor);
 			font.second->descriptorSet->create();
 		}
 	}
 
+	// Builds the glyph quads of a single element from its (cached) shaped run
+	void GameUI::layoutTextElement(TextElement* element, float aspectRatio)
+	{
+		element->vertices.clear();
+		if (!element->visible) {
+			return;
+		}
+
+		const glm::vec2 scale = { 0.0025f / aspectRatio, 0.0025f };
+		const ShapedRun& run = runCache.get(font, element->text, scale);
+
+		glm::vec2 origin = glm::vec2(element->position);
+		if (element->alignment == TextAlignment::Center) {
+			origin -= run.extent / 2.0f;
+		}
+		const float z = element->position.z;
+		const glm::vec4& color = element->color;
+
+		element->vertices.reserve(run.quads.size() * 6);
+		for (auto& quad : run.quads)
+		{
+			const glm::vec2 p0 = origin + quad.pos;
+			const glm::vec2 p1 = p0 + quad.size;
+			element->vertices.push_back({ { p0.x, p0.y, z }, { quad.uvMin.x, quad.uvMin.y }, color });
+			element->vertices.push_back({ { p0.x, p1.y, z }, { quad.uvMin.x, quad.uvMax.y }, color });
+			element->vertices.push_back({ { p1.x, p1.y, z }, { quad.uvMax.x, quad.uvMax.y }, color });
+			element->vertices.push_back({ { p1.x, p1.y, z }, { quad.uvMax.x, quad.uvMax.y }, color });
+			element->vertices.push_back({ { p1.x, p0.y, z }, { quad.uvMax.x, quad.uvMin.y }, color });
+			element->vertices.push_back({ { p0.x, p0.y, z }, { quad.uvMin.x, quad.uvMin.y }, color });
+		}
+	}
+
+	// Replaces the vertex buffer with one that has room for at least vertexCount vertices per frame
+	void GameUI::growVertexBuffer(uint32_t vertexCount)
+	{
+		uint32_t capacity = std::max(vertexCapacity, 1024u);
+		while (capacity < vertexCount) {
+			capacity *= 2;
+		}
+		// The current buffer may still be used by the frame that has just been submitted
+		if (vertexBuffer.buffer != VK_NULL_HANDLE) {
+			retiredBuffers.push_back(vertexBuffer);
+			vertexBuffer = Buffer();
+		}
+		// Host visible buffers are persistently mapped
+		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &vertexBuffer, (VkDeviceSize)capacity * frameCount * sizeof(TextVertex), nullptr, MemoryCategory::Geometry));
+		vertexCapacity = capacity;
+		stats.bufferAllocations++;
+	}
+
+	// Called once per frame, only elements that changed since the last call are laid out again and the vertex buffer is only written if anything changed
 	void GameUI::updateGPUResources()
 	{
-		//@todo: Only recreate vertex buffer if no. of vertices has changed, otherwise just copy
+		// Buffers retired by the last update were only used by frames that have finished since then
+		for (auto& buffer : retiredBuffers) {
+			buffer.destroy();
+		}
+		retiredBuffers.clear();
 
 		if (textElements.size() == 0) {
 			return;
 		}
 
-		// Get final vector size
-		size_t vertexCount = 0;
-		for (auto element : textElements)
+		const float ar = (float)renderer->width / (float)renderer->height;
+		const bool invalidateAll = (ar != layoutAspectRatio) || (font != layoutFont);
+		layoutAspectRatio = ar;
+		layoutFont = font;
+
+		bool dirty = false;
+		for (auto& element : textElements)
 		{
-			if (element.second->visible)
-			{
-				for (char& c : element.second->text)
-				{
-					if (c == '\n' || c == ' ') {
-						continue;
-					}
-					vertexCount += 6;
-				}
+			if (invalidateAll) {
+				element.second->invalidateLayout();
+			}
+			if (element.second->changed()) {
+				layoutTextElement(element.second, ar);
+				element.second->setLaidOut();
+				stats.layouts++;
+				dirty = true;
 			}
 		}
-		vertices.resize(vertexCount);
-		
-		const float ar = (float)renderer->width / (float)renderer->height;
+		if (!dirty) {
+			return;
+		}
 
-		uint32_t idx = 0;
-		for (auto element : textElements)
+		vertices.clear();
+		for (auto& element : textElements)
 		{
-			if (element.second->visible)
-			{
-				const glm::vec2 scale = { 0.0025f / ar, 0.0025f };
-
-				float width = 0.0f;
-				float height = font->lineHeight * scale.y;
-
-				float posx = element.second->position.x;
-				float posy = element.second->position.y;
-
-				const uint32_t idxStartElement = idx;
-				for (char& c : element.second->text)
-				{
-					if (c == '\n') {
-						posx = element.second->position.x;
-						posy += font->lineHeight * scale.y;
-						height += font->lineHeight * scale.y;
-						continue;
-					}
-					FontCharInfo* charInfo = &font->charInfo[(int)c];
-					if (c == ' ') {
-						posx += charInfo->width;
-						continue;
-					}
-
-					const float bw = charInfo->x + charInfo->width;
-					const float bh = charInfo->y + charInfo->height;
-
-					const float u0 = charInfo->x / (float)font->getWidth();
-					const float v1 = charInfo->y / (float)font->getHeight();
-					const float u1 = bw / (float)font->getWidth();
-					const float v0 = bh / (float)font->getHeight();
-
-					const float x = posx + charInfo->xoffset * scale.x;
-					const float y = posy + charInfo->yoffset * scale.y;
-					const float z = element.second->position.z;
-					const float w = charInfo->width * scale.x;
-					const float h = charInfo->height * scale.y;
-
-					vertices[idx].pos = { x,		y,		z }; vertices[idx].uv = { u0, v1 }; vertices[idx].color = element.second->color;
-					vertices[idx + 1].pos = { x,		y + h,	z }; vertices[idx + 1].uv = { u0, v0 }; vertices[idx + 1].color = element.second->color;
-					vertices[idx + 2].pos = { x + w,	y + h,	z }; vertices[idx + 2].uv = { u1, v0 }; vertices[idx + 2].color = element.second->color;
-					vertices[idx + 3].pos = { x + w,	y + h,	z }; vertices[idx + 3].uv = { u1, v0 }; vertices[idx + 3].color = element.second->color;
-					vertices[idx + 4].pos = { x + w,	y,		z }; vertices[idx + 4].uv = { u1, v1 }; vertices[idx + 4].color = element.second->color;
-					vertices[idx + 5].pos = { x,		y,		z }; vertices[idx + 5].uv = { u0, v1 }; vertices[idx + 5].color = element.second->color;
-
-					float advance = charInfo->xadvance * scale.x;
-					posx += advance;
-					// @todo: reset and check on line break
-					width += advance;
-					idx += 6;
-				}
-
-				if (element.second->alignment == TextAlignment::Center) {
-					for (uint32_t i = idxStartElement; i < idx; i++)
-					{
-						vertices[i].pos.x -= width / 2.0f;
-						vertices[i].pos.y -= height / 2.0f;
-					}
-				}
-			}
+			vertices.insert(vertices.end(), element.second->vertices.begin(), element.second->vertices.end());
 		}
 
-		VK_CHECK_RESULT(renderer->device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &vertexBuffer, vertices.size() * sizeof(Vertex), vertices.data()));
+		if (vertices.size() > vertexCapacity) {
+			growVertexBuffer(static_cast<uint32_t>(vertices.size()));
+		}
+		// Write to the range not used by the last submitted frame
+		frameIndex = (frameIndex + 1) % frameCount;
+		if (!vertices.empty()) {
+			memcpy(static_cast<TextVertex*>(vertexBuffer.mapped) + frameIndex * vertexCapacity, vertices.data(), vertices.size() * sizeof(TextVertex));
+		}
+		drawVertexCount = static_cast<uint32_t>(vertices.size());
+		stats.uploads++;
 	}
 
 	void GameUI::draw(CommandBuffer* cb)
 	{
-		if (textElements.size() == 0) {
+		if (drawVertexCount == 0) {
 			return;
 		}
 		assert(font);
@@ -174,11 +192,11 @@ namespace UI
 
 		cb->setViewport(0.0f, 0.0f, (float)renderer->width, (float)renderer->height, 0.0f, 1.0f);
 		cb->setScissor(0, 0, (int32_t)renderer->width, (int32_t)renderer->height);
-		cb->bindPipeline(renderer->getPipeline("msdf"));
-		cb->updatePushConstant(renderer->getPipelineLayout("ui_text"), 0, &pushConstBlock);
-		cb->bindDescriptorSets(renderer->getPipelineLayout("ui_text"), { font->descriptorSet }, 0);
+		cb->bindPipeline(pipeline);
+		cb->updatePushConstant(pipelineLayout, 0, &pushConstBlock);
+		cb->bindDescriptorSets(pipelineLayout, { font->descriptorSet }, 0);
 		cb->bindVertexBuffer(vertexBuffer, 0);
-		cb->draw(vertices.size(), 1, 0, 0);
+		cb->draw(drawVertexCount, 1, frameIndex * vertexCapacity, 0);
 	}
 
 }
\ No newline at end of file
@@ -7,12 +7,14 @@
 #pragma once
 
 #include <unordered_map> 
+#include <algorithm>
 #include "../Renderer/RenderObject.h"
 #include "../Renderer/VulkanTools.h"
 #include "../Renderer/Buffer.h"
 #include "../Renderer/CommandBuffer.h"
 #include "Font.h"
 #include "TextElement.h"
+#include "TextLayout.h"
 
 namespace UI
 {
@@ -20,20 +22,37 @@ namespace UI
     class GameUI : public RenderObject
     {
     private:
-        struct Vertex {
-            glm::vec3 pos;
-            glm::vec2 uv;
-            glm::vec4 color;
-        };
-        std::vector<Vertex> vertices;
+        // Number of vertex buffer ranges, the UI is updated after a frame has been submitted, so that frame's range may still be in use
+        static const uint32_t frameCount = 2;
+        std::vector<TextVertex> vertices;
+        // Persistent vertex buffer that only grows, split into frameCount ranges of vertexCapacity vertices each
         Buffer vertexBuffer;
+        uint32_t vertexCapacity = 0;
+        uint32_t frameIndex = 0;
+        // Buffers replaced by a larger one, destroyed once the GPU is done with them
+        std::vector<Buffer> retiredBuffers;
+        uint32_t drawVertexCount = 0;
+        float layoutAspectRatio = 0.0f;
+        Font* layoutFont = nullptr;
         std::unordered_map<std::string, Font*> fonts;
         Font* font = nullptr;
+        // Looked up once in prepareGPUResources instead of by name every frame
+        Pipeline* pipeline = nullptr;
+        PipelineLayout* pipelineLayout = nullptr;
         std::unordered_map<std::string, TextElement*> textElements;
+        void layoutTextElement(TextElement* element, float aspectRatio);
+        void growVertexBuffer(uint32_t vertexCount);
     public:
+        ShapedRunCache runCache;
+        struct Stats {
+            uint32_t bufferAllocations = 0;
+            uint32_t layouts = 0;
+            uint32_t uploads = 0;
+        } stats;
         ~GameUI();
         void addFont(std::string name);
         void setfont(std::string name);
+        Font* getFont();
         void addTextElement(std::string name, std::string text, glm::vec3 position, TextAlignment alignment, glm::vec4 color = glm::vec4(1.0f), bool visible = true);
         TextElement* getTextElement(std::string name);
         void prepareGPUResources();
@@ -8,5 +8,28 @@
 
 namespace UI
 {
+    // Returns true if any of the public properties differ from the ones used for the last layout
+    bool TextElement::changed()
+    {
+        if (!laidOut) {
+            return true;
+        }
+        return (visible != layoutState.visible) || (alignment != layoutState.alignment) || (position != layoutState.position) || (color != layoutState.color) || (text != layoutState.text);
+    }
 
-}
\ No newline at end of file
+    void TextElement::setLaidOut()
+    {
+        layoutState.visible = visible;
+        layoutState.alignment = alignment;
+        layoutState.position = position;
+        layoutState.color = color;
+        layoutState.text = text;
+        laidOut = true;
+    }
+
+    // Forces a new layout, e.g. if the font or aspect ratio changed
+    void TextElement::invalidateLayout()
+    {
+        laidOut = false;
+    }
+}
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 namespace UI
@@ -16,14 +17,35 @@ namespace UI
         Center,
     };
 
+    struct TextVertex {
+        glm::vec3 pos;
+        glm::vec2 uv;
+        glm::vec4 color;
+    };
+
     class TextElement
     {
+    private:
+        // State the glyph quads were last laid out with
+        struct LayoutState {
+            bool visible = false;
+            TextAlignment alignment = TextAlignment::TopLeft;
+            glm::vec3 position = glm::vec3(0.0f);
+            glm::vec4 color = glm::vec4(0.0f);
+            std::string text;
+        } layoutState;
+        bool laidOut = false;
     public:
         bool visible = true;
         TextAlignment alignment = TextAlignment::TopLeft;
         glm::vec3 position;
         glm::vec4 color;
         std::string text;
+        // Glyph quads of the last layout, only rebuilt if the element changed
+        std::vector<TextVertex> vertices;
+        bool changed();
+        void setLaidOut();
+        void invalidateLayout();
     };
 }
 
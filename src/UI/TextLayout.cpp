@@ -0,0 +1,93 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "TextLayout.h"
+
+namespace UI
+{
+	bool ShapedRunCache::Key::operator==(const Key& other) const
+	{
+		return (font == other.font) && (scale == other.scale) && (text == other.text);
+	}
+
+	size_t ShapedRunCache::KeyHash::operator()(const Key& key) const
+	{
+		size_t hash = std::hash<std::string>()(key.text);
+		hash ^= std::hash<Font*>()(key.font) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<float>()(key.scale.x) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<float>()(key.scale.y) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	ShapedRunCache::ShapedRunCache(size_t maxRunCount)
+	{
+		this->maxRunCount = maxRunCount;
+	}
+
+	// Returns the cached run or shapes and caches it, the reference is valid until the next call
+	const ShapedRun& ShapedRunCache::get(Font* font, const std::string& text, glm::vec2 scale)
+	{
+		Key key{ font, text, scale };
+		auto it = runs.find(key);
+		if (it != runs.end()) {
+			stats.hits++;
+			return it->second;
+		}
+		stats.misses++;
+		// Strings that change constantly would grow the cache without bounds, so it's flushed once full
+		if (runs.size() >= maxRunCount) {
+			runs.clear();
+			stats.flushes++;
+		}
+		return runs.emplace(std::move(key), shape(font, text, scale)).first->second;
+	}
+
+	size_t ShapedRunCache::size()
+	{
+		return runs.size();
+	}
+
+	void ShapedRunCache::clear()
+	{
+		runs.clear();
+	}
+
+	// Lays out a UTF-8 string with the glyph metrics of the given font
+	ShapedRun ShapedRunCache::shape(Font* font, const std::string& text, glm::vec2 scale)
+	{
+		ShapedRun run;
+		run.quads.reserve(text.size());
+		const float lineHeight = font->lineHeight * scale.y;
+		glm::vec2 pen = glm::vec2(0.0f);
+		run.extent.y = lineHeight;
+		size_t pos = 0;
+		while (pos < text.size()) {
+			const uint32_t codepoint = Font::nextCodepoint(text, pos);
+			if (codepoint == '\n') {
+				pen.x = 0.0f;
+				pen.y += lineHeight;
+				run.extent.y += lineHeight;
+				continue;
+			}
+			const FontCharInfo* glyph = font->getGlyph(codepoint);
+			if (!glyph) {
+				continue;
+			}
+			// Whitespace only advances the pen
+			if ((glyph->width > 0.0f) && (glyph->height > 0.0f) && (codepoint != ' ')) {
+				GlyphQuad quad;
+				quad.pos = pen + glm::vec2(glyph->xoffset, glyph->yoffset) * scale;
+				quad.size = glm::vec2(glyph->width, glyph->height) * scale;
+				quad.uvMin = glyph->uvMin;
+				quad.uvMax = glyph->uvMax;
+				run.quads.push_back(quad);
+			}
+			pen.x += glyph->xadvance * scale.x;
+			run.extent.x = std::max(run.extent.x, pen.x);
+		}
+		return run;
+	}
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2020, Sascha Willems
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "Font.h"
+
+namespace UI
+{
+    // Glyph quad relative to the origin of the text, in screen space
+    struct GlyphQuad {
+        glm::vec2 pos;
+        glm::vec2 size;
+        glm::vec2 uvMin;
+        glm::vec2 uvMax;
+    };
+
+    // Laid out glyphs of a string, independent of position and color
+    struct ShapedRun {
+        std::vector<GlyphQuad> quads;
+        // Width of the widest line and height of all lines
+        glm::vec2 extent = glm::vec2(0.0f);
+    };
+
+    // Caches shaped runs by font, string and scale, so strings that are displayed repeatedly (e.g. score counters) are only laid out once
+    class ShapedRunCache
+    {
+    private:
+        struct Key {
+            Font* font;
+            std::string text;
+            glm::vec2 scale;
+            bool operator==(const Key& other) const;
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+        std::unordered_map<Key, ShapedRun, KeyHash> runs;
+        size_t maxRunCount;
+    public:
+        struct Stats {
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            uint32_t flushes = 0;
+        } stats;
+        ShapedRunCache(size_t maxRunCount = 256);
+        const ShapedRun& get(Font* font, const std::string& text, glm::vec2 scale);
+        size_t size();
+        void clear();
+        static ShapedRun shape(Font* font, const std::string& text, glm::vec2 scale);
+    };
+}